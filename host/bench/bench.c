@@ -0,0 +1,752 @@
+// Replays recorded One Call responses through the firmware's portable code (HTTP parser, JSON
+// extractor, layout and framebuffer) and reports throughput, heap allocations and memory per
+// stage, so regressions show up before anything is flashed.
+//
+//   bench [-t seconds] [response.json ...]
+//
+// Without arguments the fixtures under host/fixtures are replayed, and built with miniz, their gzip
+// copies are inflated too.
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "arena.h"
+#include "frameCodec.h"
+#include "framebuffer.h"
+#include "httpParser.h"
+#include "layout.h"
+#include "raster.h"
+#include "snapshotCodec.h"
+#include "weatherJson.h"
+#if BENCH_GZIP
+#include "gzipInflate.h"
+#endif
+
+#ifndef CONFIG_HTTP_RECV_BUF_SIZE
+#define CONFIG_HTTP_RECV_BUF_SIZE 1024
+#endif
+// Chunk size the server side of the replay uses
+#define BENCH_CHUNK 1400
+#define BENCH_MIN_ITERATIONS 10
+
+typedef struct {
+  size_t calls;
+  size_t bytes;
+  size_t live;
+  size_t peak;
+} heap_stats_t;
+
+static heap_stats_t heap;
+static bool counting;
+
+#if BENCH_WRAP_MALLOC
+#include <malloc.h>
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static void *counted(void *ptr, size_t before)
+{
+  if (counting && ptr) {
+    size_t size = malloc_usable_size(ptr);
+    heap.calls++;
+    heap.bytes += size;
+    heap.live += size - before;
+    if (heap.live > heap.peak) {
+      heap.peak = heap.live;
+    }
+  }
+  return ptr;
+}
+
+void *__wrap_malloc(size_t size)
+{
+  return counted(__real_malloc(size), 0);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+  return counted(__real_calloc(n, size), 0);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+  size_t before = ptr && counting ? malloc_usable_size(ptr) : 0;
+  return counted(__real_realloc(ptr, size), before);
+}
+
+void __wrap_free(void *ptr)
+{
+  if (counting && ptr) {
+    heap.live -= malloc_usable_size(ptr);
+  }
+  __real_free(ptr);
+}
+#endif
+
+// One recorded response, as the body and as the chunked HTTP response a server would send
+typedef struct {
+  const char *name;
+  uint8_t *body;
+  size_t bodyLen;
+  uint8_t *response;
+  size_t responseLen;
+  uint8_t *gzip;  // Gzip copy of the body, NULL if there's none
+  size_t gzipLen;
+} fixture_t;
+
+typedef struct {
+  const fixture_t *fx;
+  weather_parser_t parser;
+  weather_snapshot_t snap;
+  framebuffer_t *fb;  // NULL to only parse
+  size_t bodyBytes;
+  uint8_t frame[SNAPSHOT_FRAME_MAX];
+  size_t frameLen;
+  const uint8_t (*ref)[FB_PLANE_SIZE];  // Frame before, for the stored delta
+  size_t storedLen;
+} run_ctx_t;
+
+typedef void (*bench_fn_t)(run_ctx_t *run);
+
+static double minSeconds = 0.5;
+
+static double nowSeconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint8_t *readFile(const char *path, size_t *len)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    return NULL;
+  }
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t *buf = malloc(size > 0 ? size : 1);
+  if (buf && fread(buf, 1, size, f) != (size_t)size) {
+    free(buf);
+    buf = NULL;
+  }
+  fclose(f);
+  *len = size;
+  return buf;
+}
+
+static bool loadFixture(fixture_t *fx, const char *path)
+{
+  fx->body = readFile(path, &fx->bodyLen);
+  if (!fx->body) {
+    fprintf(stderr, "can't read %s\n", path);
+    return false;
+  }
+  const char *slash = strrchr(path, '/');
+  fx->name = slash ? slash + 1 : path;
+
+  // Headers along the lines of what the API sends, then the body in chunks
+  static const char head[] =
+      "HTTP/1.1 200 OK\r\n"
+      "Server: openresty\r\n"
+      "Date: Tue, 14 Oct 2025 12:00:00 GMT\r\n"
+      "Content-Type: application/json; charset=utf-8\r\n"
+      "Transfer-Encoding: chunked\r\n"
+      "Connection: close\r\n"
+      "X-Cache-Key: /data/3.0/onecall?exclude=minutely%2Calerts&lat=51.51&lon=-0.13&units=metric\r\n"
+      "Access-Control-Allow-Origin: *\r\n"
+      "\r\n";
+  size_t chunks = (fx->bodyLen + BENCH_CHUNK - 1) / BENCH_CHUNK;
+  fx->response = malloc(sizeof(head) + fx->bodyLen + chunks * 16 + 8);
+  size_t len = sizeof(head) - 1;
+  memcpy(fx->response, head, len);
+  for (size_t ofs = 0; ofs < fx->bodyLen; ofs += BENCH_CHUNK) {
+    size_t n = fx->bodyLen - ofs < BENCH_CHUNK ? fx->bodyLen - ofs : BENCH_CHUNK;
+    len += sprintf((char *)fx->response + len, "%zx\r\n", n);
+    memcpy(fx->response + len, fx->body + ofs, n);
+    len += n;
+    memcpy(fx->response + len, "\r\n", 2);
+    len += 2;
+  }
+  memcpy(fx->response + len, "0\r\n\r\n", 5);
+  fx->responseLen = len + 5;
+  return true;
+}
+
+static void onSection(void *ctx, const weather_snapshot_t *snap, weather_section_t section)
+{
+  run_ctx_t *run = ctx;
+  if (run->fb) {
+    layoutRender(run->fb, snap, section);
+  }
+}
+
+static void onBody(void *ctx, const uint8_t *data, size_t len)
+{
+  run_ctx_t *run = ctx;
+  run->bodyBytes += len;
+  weatherParserFeed(&run->parser, data, len);
+}
+
+static void onField(void *ctx, const weather_field_t *field)
+{
+  layoutField(((run_ctx_t *)ctx)->fb, field);
+}
+
+static void onBodyCount(void *ctx, const uint8_t *data, size_t len)
+{
+  ((run_ctx_t *)ctx)->bodyBytes += len;
+}
+
+// Feed the response the way socket reads hand it over, in receive buffer sized slices
+static void replay(run_ctx_t *run, const http_callbacks_t *cb)
+{
+  http_parser_t *parser = arenaAlloc(sizeof(*parser));
+  httpParserInit(parser, cb);
+  for (size_t ofs = 0; ofs < run->fx->responseLen && !httpParserDone(parser);) {
+    size_t n = run->fx->responseLen - ofs;
+    if (n > CONFIG_HTTP_RECV_BUF_SIZE) {
+      n = CONFIG_HTTP_RECV_BUF_SIZE;
+    }
+    httpParserFeed(parser, run->fx->response + ofs, n);
+    ofs += n;
+  }
+  if (!httpParserDone(parser)) {
+    fprintf(stderr, "%s: response didn't parse\n", run->fx->name);
+    exit(1);
+  }
+  arenaFree(parser);
+}
+
+static void benchHttp(run_ctx_t *run)
+{
+  const http_callbacks_t cb = {.onBody = onBodyCount, .ctx = run};
+  run->bodyBytes = 0;
+  replay(run, &cb);
+  if (run->bodyBytes != run->fx->bodyLen) {
+    fprintf(stderr, "%s: body came out %zu bytes, not %zu\n", run->fx->name, run->bodyBytes,
+            run->fx->bodyLen);
+    exit(1);
+  }
+}
+
+static void benchJson(run_ctx_t *run)
+{
+  weatherParserInit(&run->parser, &run->snap, NULL, NULL);
+  for (size_t ofs = 0; ofs < run->fx->bodyLen; ofs += CONFIG_HTTP_RECV_BUF_SIZE) {
+    size_t n = run->fx->bodyLen - ofs;
+    weatherParserFeed(&run->parser, run->fx->body + ofs,
+                      n < CONFIG_HTTP_RECV_BUF_SIZE ? n : CONFIG_HTTP_RECV_BUF_SIZE);
+  }
+  if (!weatherParserFinish(&run->parser)) {
+    fprintf(stderr, "%s: body didn't parse\n", run->fx->name);
+    exit(1);
+  }
+}
+
+#if BENCH_GZIP
+// The inflated body has to match the fixture it was compressed from
+static void onInflated(void *ctx, const uint8_t *data, size_t len)
+{
+  run_ctx_t *run = ctx;
+  if (run->bodyBytes + len > run->fx->bodyLen ||
+      memcmp(run->fx->body + run->bodyBytes, data, len) != 0) {
+    fprintf(stderr, "%s: inflated body doesn't match the fixture\n", run->fx->name);
+    exit(1);
+  }
+  run->bodyBytes += len;
+}
+
+// Inflate gz handed over step bytes at a time, true if it all came out and the trailer agrees
+static bool gunzip(run_ctx_t *run, const uint8_t *gz, size_t len, size_t step)
+{
+  static gzip_inflater_t inflater;
+  static uint8_t dict[GZIP_DICT_SIZE];
+  gzipInit(&inflater, dict, onInflated, run);
+  run->bodyBytes = 0;
+  for (size_t ofs = 0; ofs < len; ofs += step) {
+    gzipFeed(&inflater, gz + ofs, len - ofs < step ? len - ofs : step);
+  }
+  return gzipFinish(&inflater) && run->bodyBytes == run->fx->bodyLen;
+}
+
+// What http.c does with a gzip body, on the gzip copy of the fixture
+static void benchGunzip(run_ctx_t *run)
+{
+  if (!gunzip(run, run->fx->gzip, run->fx->gzipLen, BENCH_CHUNK)) {
+    fprintf(stderr, "%s: gzip copy didn't inflate\n", run->fx->name);
+    exit(1);
+  }
+}
+
+// A byte at a time splits the header and trailer every way, and a bad trailer has to be caught
+static void checkGunzip(run_ctx_t *run)
+{
+  const fixture_t *fx = run->fx;
+  uint8_t *bad = malloc(fx->gzipLen);
+  memcpy(bad, fx->gzip, fx->gzipLen);
+  bad[fx->gzipLen - 8] ^= 0x01;  // CRC32
+  if (!gunzip(run, fx->gzip, fx->gzipLen, 1) || gunzip(run, bad, fx->gzipLen, BENCH_CHUNK) ||
+      gunzip(run, fx->gzip, fx->gzipLen - 1, BENCH_CHUNK)) {
+    fprintf(stderr, "%s: gzip trailer check failed\n", fx->name);
+    exit(1);
+  }
+  free(bad);
+}
+#endif
+
+// What a hub and a node do with a parsed forecast, the decode has to give it back unchanged
+static void benchCodec(run_ctx_t *run)
+{
+  static weather_snapshot_t decoded;
+  uint8_t location;
+  run->frameLen = snapshotEncode(&run->snap, 0, run->frame, sizeof(run->frame));
+  if (!snapshotDecode(run->frame, run->frameLen, &location, &decoded) ||
+      memcmp(&decoded, &run->snap, sizeof(decoded)) != 0) {
+    fprintf(stderr, "%s: snapshot didn't survive the codec\n", run->fx->name);
+    exit(1);
+  }
+}
+
+// Everything a wake does with the response: HTTP, JSON, and the layout drawing each section as
+// it completes, onto a blank frame
+static void benchPipeline(run_ctx_t *run)
+{
+  const http_callbacks_t cb = {.onBody = onBody, .ctx = run};
+  fbClear(run->fb, FB_WHITE);
+  layoutBegin(false);
+  weatherParserInit(&run->parser, &run->snap, onSection, run);
+  replay(run, &cb);
+  weatherParserFinish(&run->parser);
+}
+
+// Same as the pipeline with no snapshot in between, the parser's fields go straight to the layout
+static void benchStream(run_ctx_t *run)
+{
+  const http_callbacks_t cb = {.onBody = onBody, .ctx = run};
+  fbClear(run->fb, FB_WHITE);
+  layoutBegin(false);
+  weatherFieldParserInit(&run->parser, false, onField, run);
+  replay(run, &cb);
+  weatherParserFinish(&run->parser);
+}
+
+static void benchRenderFull(run_ctx_t *run)
+{
+  fbClear(run->fb, FB_WHITE);
+  layoutBegin(false);
+  layoutRender(run->fb, &run->snap, WEATHER_SECTION_ALL);
+}
+
+// Same forecast as the committed frame, nothing should need drawing
+static void benchRenderUnchanged(run_ctx_t *run)
+{
+  layoutBegin(true);
+  layoutRender(run->fb, &run->snap, WEATHER_SECTION_ALL);
+}
+
+// What the frame store writes before a deep sleep, and reads back next wake
+typedef struct {
+  uint8_t buf[FB_PLANE_SIZE * 2];
+  size_t len;
+} stored_t;
+
+static void appendStored(void *ctx, const uint8_t *data, size_t len)
+{
+  stored_t *stored = ctx;
+  if (stored->len + len <= sizeof(stored->buf)) {
+    memcpy(stored->buf + stored->len, data, len);
+  }
+  stored->len += len;
+}
+
+// What the frame store writes before a deep sleep, and reads back next wake
+static void benchFrameStore(run_ctx_t *run)
+{
+  static stored_t stored;
+  static uint8_t loaded[FB_PLANE_SIZE];
+  run->storedLen = 0;
+  for (int p = 0; p < FB_PLANES; p++) {
+    const uint8_t *ref = run->ref ? run->ref[p] : NULL;
+    stored.len = 0;
+    frameEncode(run->fb->planes[p], ref, FB_PLANE_SIZE, appendStored, &stored);
+    if (stored.len > sizeof(stored.buf) ||
+        frameDecode(stored.buf, stored.len, ref, loaded, FB_PLANE_SIZE) != stored.len ||
+        memcmp(loaded, run->fb->planes[p], FB_PLANE_SIZE) != 0) {
+      fprintf(stderr, "%s: frame didn't survive the frame codec\n", run->fx->name);
+      exit(1);
+    }
+    run->storedLen += stored.len;
+  }
+}
+
+// Run fn for at least minSeconds and print a result line
+static void measure(const char *stage, bench_fn_t fn, run_ctx_t *run, size_t bytes)
+{
+  fn(run);  // Warm up, and the snapshot for the render stages
+
+  arenaReset();
+  heap = (heap_stats_t){0};
+  counting = true;
+  size_t iterations = 0;
+  double start = nowSeconds();
+  double elapsed;
+  do {
+    fn(run);
+    iterations++;
+    elapsed = nowSeconds() - start;
+  } while (iterations < BENCH_MIN_ITERATIONS || elapsed < minSeconds);
+  counting = false;
+
+  double usPerIter = elapsed * 1e6 / iterations;
+  printf("%-18s %-18s %10.1f", run->fx->name, stage, usPerIter);
+  if (bytes) {
+    printf(" %9.1f", bytes / (elapsed / iterations) / 1e6);
+  } else {
+    printf(" %9s", "-");
+  }
+  printf(" %8.2f %8zu %8zu\n", (double)heap.calls / iterations, heap.peak, arenaHighWater());
+}
+
+static void runFixture(const fixture_t *fx)
+{
+  static run_ctx_t run;
+  run = (run_ctx_t){.fx = fx};
+  measure("http", benchHttp, &run, fx->responseLen);
+  measure("json", benchJson, &run, fx->bodyLen);
+#if BENCH_GZIP
+  if (fx->gzip) {
+    measure("gunzip", benchGunzip, &run, fx->bodyLen);
+    checkGunzip(&run);
+  }
+#endif
+  measure("codec", benchCodec, &run, 0);
+  printf("%-18s %-18s %zu byte frame for a %zu byte snapshot\n", fx->name, "frame", run.frameLen,
+         sizeof(run.snap));
+  run.fb = fbMain();
+  measure("pipeline", benchPipeline, &run, fx->responseLen);
+  static uint8_t expected[FB_PLANES][FB_PLANE_SIZE];
+  for (int p = 0; p < FB_PLANES; p++) {
+    memcpy(expected[p], run.fb->planes[p], FB_PLANE_SIZE);
+  }
+  measure("stream", benchStream, &run, fx->responseLen);
+  for (int p = 0; p < FB_PLANES; p++) {
+    if (memcmp(expected[p], run.fb->planes[p], FB_PLANE_SIZE) != 0) {
+      fprintf(stderr, "%s: streamed frame doesn't match the snapshot one\n", fx->name);
+      exit(1);
+    }
+  }
+  measure("render-full", benchRenderFull, &run, 0);
+  benchRenderFull(&run);
+  layoutCommit();
+  measure("render-unchanged", benchRenderUnchanged, &run, 0);
+  measure("frame-full", benchFrameStore, &run, FB_SIZE);
+  size_t fullLen = run.storedLen;
+  static uint8_t committed[FB_PLANES][FB_PLANE_SIZE];
+  for (int p = 0; p < FB_PLANES; p++) {
+    memcpy(committed[p], run.fb->planes[p], FB_PLANE_SIZE);
+  }
+
+  fb_rect_t dirty;
+  // Current temperature a degree warmer, the smallest change that still needs a refresh
+  run.snap.temp += 10;
+  layoutBegin(true);
+  layoutRender(run.fb, &run.snap, WEATHER_SECTION_ALL);
+  if (layoutDirty(&dirty)) {
+    printf("%-18s %-18s %dx%d of %dx%d redrawn for a 1 degree change\n", fx->name, "dirty",
+           dirty.w, dirty.h, FB_WIDTH, FB_HEIGHT);
+  }
+  run.ref = committed;
+  measure("frame-delta", benchFrameStore, &run, FB_SIZE);
+  printf("%-18s %-18s %zu bytes full, %zu as a delta, of %d raw\n", fx->name, "stored", fullLen,
+         run.storedLen, FB_SIZE);
+}
+
+// Raster kernels (raster.h) against the same job done a pixel at a time, which has to agree
+#define KERNEL_RECTS 64
+#define KERNEL_BLITS 256
+#define GLYPH_WIDTH 21
+#define GLYPH_HEIGHT 24
+
+static uint8_t kernelSrc[FB_PLANE_SIZE] __attribute__((aligned(4)));
+static uint8_t kernelOther[FB_PLANE_SIZE] __attribute__((aligned(4)));
+static uint8_t kernelOut[FB_PLANE_SIZE] __attribute__((aligned(4)));
+static uint8_t kernelRef[FB_PLANE_SIZE] __attribute__((aligned(4)));
+static uint8_t *kernelDst;  // Where the one being run writes
+static fb_rect_t kernelRects[KERNEL_RECTS];
+static uint8_t glyph[GLYPH_HEIGHT][(GLYPH_WIDTH + 7) / 8];
+static fb_rect_t diffBounds;
+static bool diffAny;
+
+static inline bool getBit(const uint8_t *plane, int stride, int x, int y)
+{
+  return plane[(size_t)y * stride + (x >> 3)] & (0x80 >> (x & 7));
+}
+
+static inline void putBit(uint8_t *plane, int stride, int x, int y, bool on)
+{
+  uint8_t *b = &plane[(size_t)y * stride + (x >> 3)];
+  *b = on ? *b | (0x80 >> (x & 7)) : *b & ~(0x80 >> (x & 7));
+}
+
+static void spanKernel(void)
+{
+  for (int i = 0; i < KERNEL_RECTS; i++) {
+    const fb_rect_t *r = &kernelRects[i];
+    for (int y = r->y; y < r->y + r->h; y++) {
+      rasterSpan(kernelDst + (size_t)y * FB_STRIDE, r->x, r->x + r->w,
+                 i & 1 ? RASTER_SET : RASTER_CLEAR);
+    }
+  }
+}
+
+static void spanPixel(void)
+{
+  for (int i = 0; i < KERNEL_RECTS; i++) {
+    const fb_rect_t *r = &kernelRects[i];
+    for (int y = r->y; y < r->y + r->h; y++) {
+      for (int x = r->x; x < r->x + r->w; x++) {
+        putBit(kernelDst, FB_STRIDE, x, y, i & 1);
+      }
+    }
+  }
+}
+
+static void invertKernel(void)
+{
+  for (int i = 0; i < KERNEL_RECTS; i++) {
+    const fb_rect_t *r = &kernelRects[i];
+    for (int y = r->y; y < r->y + r->h; y++) {
+      rasterSpan(kernelDst + (size_t)y * FB_STRIDE, r->x, r->x + r->w, RASTER_INVERT);
+    }
+  }
+}
+
+static void invertPixel(void)
+{
+  for (int i = 0; i < KERNEL_RECTS; i++) {
+    const fb_rect_t *r = &kernelRects[i];
+    for (int y = r->y; y < r->y + r->h; y++) {
+      for (int x = r->x; x < r->x + r->w; x++) {
+        putBit(kernelDst, FB_STRIDE, x, y, !getBit(kernelDst, FB_STRIDE, x, y));
+      }
+    }
+  }
+}
+
+// Glyph sized blits landing on every bit offset
+static void blitKernel(void)
+{
+  for (int i = 0; i < KERNEL_BLITS; i++) {
+    int x = i * 37 % (FB_WIDTH - GLYPH_WIDTH), y = i * 53 % (FB_HEIGHT - GLYPH_HEIGHT);
+    for (int row = 0; row < GLYPH_HEIGHT; row++) {
+      rasterBlit(kernelDst + (size_t)(y + row) * FB_STRIDE, x, glyph[row], GLYPH_WIDTH, i & 1);
+    }
+  }
+}
+
+static void blitPixel(void)
+{
+  for (int i = 0; i < KERNEL_BLITS; i++) {
+    int x = i * 37 % (FB_WIDTH - GLYPH_WIDTH), y = i * 53 % (FB_HEIGHT - GLYPH_HEIGHT);
+    for (int row = 0; row < GLYPH_HEIGHT; row++) {
+      for (int col = 0; col < GLYPH_WIDTH; col++) {
+        if (getBit(glyph[row], 0, col, 0)) {
+          putBit(kernelDst, FB_STRIDE, x + col, y + row, i & 1);
+        }
+      }
+    }
+  }
+}
+
+static void diffKernel(void)
+{
+  diffAny = rasterDiff(kernelSrc, kernelOther, &diffBounds);
+}
+
+static void diffPixel(void)
+{
+  int x0 = FB_WIDTH, y0 = FB_HEIGHT, x1 = -1, y1 = -1;
+  for (int y = 0; y < FB_HEIGHT; y++) {
+    for (int x = 0; x < FB_WIDTH; x++) {
+      if (getBit(kernelSrc, FB_STRIDE, x, y) != getBit(kernelOther, FB_STRIDE, x, y)) {
+        x0 = x < x0 ? x : x0;
+        x1 = x > x1 ? x : x1;
+        y0 = y < y0 ? y : y0;
+        y1 = y;
+      }
+    }
+  }
+  diffAny = x1 >= 0;
+  diffBounds = (fb_rect_t){.x = x0, .y = y0, .w = x1 - x0 + 1, .h = y1 - y0 + 1};
+}
+
+static void rotate180Kernel(void)
+{
+  rasterRotate180(kernelDst, FB_WIDTH, FB_HEIGHT);
+}
+
+static void rotate180Pixel(void)
+{
+  for (int y = 0; y < FB_HEIGHT / 2; y++) {
+    for (int x = 0; x < FB_WIDTH; x++) {
+      int mx = FB_WIDTH - 1 - x, my = FB_HEIGHT - 1 - y;
+      bool a = getBit(kernelDst, FB_STRIDE, x, y);
+      putBit(kernelDst, FB_STRIDE, x, y, getBit(kernelDst, FB_STRIDE, mx, my));
+      putBit(kernelDst, FB_STRIDE, mx, my, a);
+    }
+  }
+}
+
+// kernelSrc read as a portrait frame, the panel's sides swapped
+static void rotate90Kernel(void)
+{
+  rasterRotate90(kernelSrc, FB_HEIGHT, FB_WIDTH, kernelDst);
+}
+
+static void rotate90Pixel(void)
+{
+  for (int y = 0; y < FB_WIDTH; y++) {
+    for (int x = 0; x < FB_HEIGHT; x++) {
+      putBit(kernelDst, FB_STRIDE, FB_WIDTH - 1 - y, x, getBit(kernelSrc, FB_HEIGHT / 8, x, y));
+    }
+  }
+}
+
+static double timeKernel(void (*fn)(void))
+{
+  size_t iterations = 0;
+  double start = nowSeconds();
+  double elapsed;
+  do {
+    fn();
+    iterations++;
+    elapsed = nowSeconds() - start;
+  } while (iterations < BENCH_MIN_ITERATIONS || elapsed < minSeconds);
+  return elapsed * 1e6 / iterations;
+}
+
+static void benchKernel(const char *name, void (*kernel)(void), void (*perPixel)(void))
+{
+  memcpy(kernelOut, kernelSrc, FB_PLANE_SIZE);
+  memcpy(kernelRef, kernelSrc, FB_PLANE_SIZE);
+  kernelDst = kernelOut;
+  kernel();
+  fb_rect_t bounds = diffBounds;
+  bool any = diffAny;
+  kernelDst = kernelRef;
+  perPixel();
+  if (memcmp(kernelOut, kernelRef, FB_PLANE_SIZE) != 0 || any != diffAny ||
+      memcmp(&bounds, &diffBounds, sizeof(bounds)) != 0) {
+    fprintf(stderr, "%s kernel doesn't match the per pixel version\n", name);
+    exit(1);
+  }
+
+  kernelDst = kernelOut;
+  double us = timeKernel(kernel);
+  double pixelUs = timeKernel(perPixel);
+  printf("%-18s %10.1f %10.1f %8.1fx\n", name, us, pixelUs, pixelUs / us);
+}
+
+static void runKernels(void)
+{
+  uint32_t seed = 0x2545F491;
+  for (int i = 0; i < FB_PLANE_SIZE; i++) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    kernelSrc[i] = seed;
+  }
+  memcpy(kernelOther, kernelSrc, FB_PLANE_SIZE);
+  kernelOther[FB_STRIDE * 200 + 31] ^= 0x10;
+  kernelOther[FB_STRIDE * 260 + 64] ^= 0x81;
+  for (int i = 0; i < KERNEL_RECTS; i++) {
+    int x = i * 97 % (FB_WIDTH - 1), y = i * 61 % (FB_HEIGHT - 1);
+    kernelRects[i] = (fb_rect_t){.x = x, .y = y, .w = 1 + i * 131 % (FB_WIDTH - x),
+                                 .h = 1 + i * 17 % (FB_HEIGHT - y) % 64};
+  }
+  for (int row = 0; row < GLYPH_HEIGHT; row++) {
+    glyph[row][0] = 0xA5 ^ row;
+    glyph[row][1] = 0x3C + row;
+    glyph[row][2] = (0xF0 | row) & (0xFF << (8 - GLYPH_WIDTH % 8));
+  }
+
+  printf("\n%-18s %10s %10s %9s\n", "kernel", "us/iter", "per pixel", "speedup");
+  benchKernel("span", spanKernel, spanPixel);
+  benchKernel("invert", invertKernel, invertPixel);
+  benchKernel("blit", blitKernel, blitPixel);
+  benchKernel("diff", diffKernel, diffPixel);
+  benchKernel("rotate180", rotate180Kernel, rotate180Pixel);
+  benchKernel("rotate90", rotate90Kernel, rotate90Pixel);
+}
+
+static int loadDefaults(fixture_t *fixtures, int max)
+{
+  DIR *dir = opendir(BENCH_FIXTURES);
+  if (!dir) {
+    fprintf(stderr, "no fixtures in " BENCH_FIXTURES "\n");
+    return 0;
+  }
+  int count = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) && count < max) {
+    size_t len = strlen(entry->d_name);
+    if (len > 5 && !strcmp(entry->d_name + len - 5, ".json")) {
+      char path[1024];
+      snprintf(path, sizeof(path), "%s/%s", BENCH_FIXTURES, entry->d_name);
+      if (loadFixture(&fixtures[count], strdup(path))) {
+#if BENCH_GZIP
+        // The build only makes gzip copies of these
+        snprintf(path, sizeof(path), "%s/%s.gz", BENCH_GZIP_FIXTURES, entry->d_name);
+        fixtures[count].gzip = readFile(path, &fixtures[count].gzipLen);
+#endif
+        count++;
+      }
+    }
+  }
+  closedir(dir);
+  return count;
+}
+
+int main(int argc, char **argv)
+{
+  enum { MAX_FIXTURES = 32 };
+  static fixture_t fixtures[MAX_FIXTURES];
+  int count = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+      minSeconds = atof(argv[++i]);
+    } else if (count < MAX_FIXTURES) {
+      count += loadFixture(&fixtures[count], argv[i]);
+    }
+  }
+  if (count == 0) {
+    count = loadDefaults(fixtures, MAX_FIXTURES);
+  }
+  if (count == 0) {
+    return 1;
+  }
+
+  printf("static: http parser %zu, weather parser %zu, snapshot %zu, frame %d bytes\n\n",
+         sizeof(http_parser_t), sizeof(weather_parser_t), sizeof(weather_snapshot_t), FB_SIZE);
+  printf("%-18s %-18s %10s %9s %8s %8s %8s\n", "fixture", "stage", "us/iter", "MB/s",
+         "allocs", "heap", "arena");
+  for (int i = 0; i < count; i++) {
+    runFixture(&fixtures[i]);
+  }
+  runKernels();
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  printf("\npeak RSS %ld KB\n", usage.ru_maxrss);
+  return 0;
+}
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Collect the hardware-in-the-loop benchmark's cycle records (CONFIG_HIL_BENCH) off the console.
+
+Reads the csv lines the firmware prints after each cycle, from a serial port (needs pyserial)
+or from a saved log on stdin, until the run ends. Writes them out as a CSV file, one row per
+cycle, and prints the median and 90th percentile of every column. With --baseline, medians are
+compared against an earlier run's file and anything that got slower by more than --threshold
+percent fails the run.
+
+  host/hil/collect.py --port /dev/ttyUSB0 -o build-hil/run.csv --baseline last-release.csv
+  idf.py monitor | tee log.txt; host/hil/collect.py -o run.csv < log.txt
+"""
+
+import argparse
+import csv
+import statistics
+import sys
+
+# Columns that aren't a time, left out of the comparison
+NOT_TIMES = {"cycle", "rx", "rssi", "bat", "retries"}
+DONE = "benchmark run done"
+
+
+def lines(args):
+    if not args.port:
+        yield from sys.stdin
+        return
+    import serial
+
+    with serial.Serial(args.port, args.baud, timeout=1) as port:
+        while True:
+            line = port.readline()
+            if line:
+                yield line.decode(errors="replace")
+
+
+def collect(args):
+    header, rows = None, []
+    for line in lines(args):
+        if DONE in line:
+            break
+        # Log output from the other core can land in front of a record
+        at = line.find("csv,")
+        if at < 0:
+            continue
+        fields = line[at:].strip().split(",")[1:]
+        if fields[0] == "cycle":
+            header, rows = fields, []
+        elif header and len(fields) == len(header):
+            rows.append([int(v) for v in fields])
+            if args.cycles and len(rows) >= args.cycles:
+                break
+    return header, rows
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def summary(header, rows):
+    cols = {name: [r[i] for r in rows] for i, name in enumerate(header) if name != "cycle"}
+    return {name: (statistics.median(v), percentile(v, 90)) for name, v in cols.items()}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--port", help="serial port, stdin if not given")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--cycles", type=int, default=0,
+                        help="stop after this many records, default when the run says it's done")
+    parser.add_argument("--skip", type=int, default=1,
+                        help="leading cycles left out of the summary (the cold boot's full "
+                             "handshake and scan)")
+    parser.add_argument("-o", "--output", required=True, help="CSV file to write")
+    parser.add_argument("--baseline", help="an earlier run's CSV file to compare against")
+    parser.add_argument("--threshold", type=float, default=10,
+                        help="percent slower than the baseline median that counts as a regression")
+    args = parser.parse_args()
+
+    header, rows = collect(args)
+    if not rows:
+        sys.exit("no cycle records seen")
+    with open(args.output, "w", newline="") as f:
+        out = csv.writer(f)
+        out.writerow(header)
+        out.writerows(rows)
+
+    measured = rows[args.skip:] or rows
+    stats = summary(header, measured)
+    base = None
+    if args.baseline:
+        with open(args.baseline, newline="") as f:
+            reader = csv.reader(f)
+            baseHeader = next(reader)
+            baseRows = [[int(v) for v in r] for r in reader]
+        base = summary(baseHeader, baseRows[args.skip:] or baseRows)
+
+    print("%d cycles, %d summarized" % (len(rows), len(measured)))
+    print("%-10s %8s %8s %10s" % ("", "median", "p90", "baseline"))
+    regressed = []
+    for name, (median, p90) in stats.items():
+        line = "%-10s %8g %8g" % (name, median, p90)
+        if base and name in base:
+            was = base[name][0]
+            change = (median - was) * 100 / was if was else 0
+            line += " %10g %+6.1f%%" % (was, change)
+            if name not in NOT_TIMES and was and change > args.threshold:
+                regressed.append(name)
+        print(line)
+    if regressed:
+        sys.exit("slower than the baseline: " + ", ".join(regressed))
+
+
+if __name__ == "__main__":
+    main()
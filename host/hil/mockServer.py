@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""Stand-in for the weather API for the hardware-in-the-loop benchmark (CONFIG_HIL_BENCH).
+
+Serves a recorded One Call response on the forecast path and a fixed air quality index on the
+air pollution path, plain HTTP/1.1 with keep-alive and gzip like the real API. Timestamps are
+moved up to the present so the panel draws what it would on the day. What changes from one
+request to the next is up to --mode:
+
+  change  the current temperature moves every request, so every cycle redraws (the default)
+  same    the same body every time, the device fetches and parses but skips the refresh
+  304     an ETag, and 304 Not Modified when the device sends it back
+
+  host/hil/mockServer.py --port 8080 --latency-ms 40
+"""
+
+import argparse
+import gzip
+import hashlib
+import json
+import os
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+FIXTURE = os.path.join(os.path.dirname(__file__), "..", "fixtures", "onecall.json")
+
+
+def shifted(forecast, now):
+    """The forecast with every dt moved by whole hours so current.dt is just before now."""
+    offset = (now - forecast["current"]["dt"]) // 3600 * 3600
+    out = json.loads(json.dumps(forecast))
+    out["current"]["dt"] += offset
+    for section in ("hourly", "daily"):
+        for entry in out.get(section, []):
+            entry["dt"] += offset
+    return out
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    requests = 0
+
+    def do_GET(self):
+        args = self.server.args
+        time.sleep(args.latency_ms / 1000)
+        now = int(time.time())
+
+        if args.air_path in self.path:
+            body = json.dumps({"list": [{"main": {"aqi": 2}, "dt": now}]}).encode()
+            self.reply(200, body)
+            return
+        if args.forecast_path not in self.path:
+            self.reply(404, b"")
+            return
+
+        Handler.requests += 1
+        forecast = shifted(self.server.forecast, now)
+        if args.mode == "change":
+            forecast["current"]["temp"] += Handler.requests % 10 / 10
+        body = json.dumps(forecast, separators=(",", ":")).encode()
+
+        headers = {"Cache-Control": "max-age=600"}
+        if args.mode == "304":
+            etag = '"%s"' % hashlib.sha1(json.dumps(self.server.forecast).encode()).hexdigest()
+            headers["ETag"] = etag
+            if self.headers.get("If-None-Match") == etag:
+                self.reply(304, b"", headers)
+                return
+        self.reply(200, body, headers)
+
+    def reply(self, status, body, headers=None):
+        gz = body and "gzip" in self.headers.get("Accept-Encoding", "")
+        if gz:
+            body = gzip.compress(body)
+        # send_response() adds the Date header the device takes its clock from
+        self.send_response(status)
+        if status != 304:
+            self.send_header("Content-Type", "application/json; charset=utf-8")
+            self.send_header("Content-Length", str(len(body)))
+        if gz:
+            self.send_header("Content-Encoding", "gzip")
+        for name, value in (headers or {}).items():
+            self.send_header(name, value)
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, fmt, *args):
+        if self.server.args.verbose:
+            super().log_message(fmt, *args)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--port", type=int, default=8080, help="CONFIG_WEATHER_API_PORT")
+    parser.add_argument("--fixture", default=FIXTURE, help="One Call response to serve")
+    parser.add_argument("--mode", choices=("change", "same", "304"), default="change")
+    parser.add_argument("--latency-ms", type=int, default=0,
+                        help="delay before each response, for a WAN-like first byte time")
+    parser.add_argument("--forecast-path", default="/data/3.0/onecall")
+    parser.add_argument("--air-path", default="/data/2.5/air_pollution")
+    parser.add_argument("-v", "--verbose", action="store_true", help="log every request")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer(("", args.port), Handler)
+    server.args = args
+    with open(args.fixture) as f:
+        server.forecast = json.load(f)
+    print("serving %s on port %d (%s)" % (args.fixture, args.port, args.mode))
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
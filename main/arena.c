@@ -0,0 +1,122 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+// mbedTLS allocates from here, and the Wi-Fi task uses mbedTLS too
+static portMUX_TYPE arenaLock = portMUX_INITIALIZER_UNLOCKED;
+#define ARENA_LOCK() portENTER_CRITICAL(&arenaLock)
+#define ARENA_UNLOCK() portEXIT_CRITICAL(&arenaLock)
+#else
+#define ARENA_LOCK()
+#define ARENA_UNLOCK()
+#endif
+
+#ifndef CONFIG_ARENA_SIZE
+#define CONFIG_ARENA_SIZE (96 * 1024)
+#endif
+
+#define ARENA_ALIGN 8
+#define ARENA_NONE UINT32_MAX
+#define BLOCK_FREED 1u  // Low bit of size, sizes are multiples of ARENA_ALIGN
+
+// Ahead of every allocation, links back to the one below so frees can unwind past blocks that
+// were freed out of order
+typedef struct {
+  uint32_t prev;  // Offset of the previous block's header
+  uint32_t size;  // Header included
+} arena_block_t;
+
+_Static_assert(sizeof(arena_block_t) % ARENA_ALIGN == 0, "arena header breaks alignment");
+
+static uint8_t arenaMemory[CONFIG_ARENA_SIZE] __attribute__((aligned(ARENA_ALIGN)));
+static size_t top;
+static uint32_t last = ARENA_NONE;
+static size_t highWater;
+
+static inline arena_block_t *blockAt(uint32_t offset)
+{
+  return (arena_block_t *)(arenaMemory + offset);
+}
+
+void *arenaAlloc(size_t size)
+{
+  size_t need = sizeof(arena_block_t) + ((size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1));
+
+  ARENA_LOCK();
+  if (size == 0 || need > sizeof(arenaMemory) - top) {
+    ARENA_UNLOCK();
+    return NULL;
+  }
+  arena_block_t *block = blockAt(top);
+  block->prev = last;
+  block->size = need;
+  last = top;
+  top += need;
+  if (top > highWater) {
+    highWater = top;
+  }
+  ARENA_UNLOCK();
+
+  return block + 1;
+}
+
+void *arenaCalloc(size_t n, size_t size)
+{
+  if (size && n > SIZE_MAX / size) {
+    return NULL;
+  }
+  void *ptr = arenaAlloc(n * size);
+  if (ptr) {
+    memset(ptr, 0, n * size);
+  }
+  return ptr;
+}
+
+void arenaFree(void *ptr)
+{
+  if (!ptr) {
+    return;
+  }
+
+  ARENA_LOCK();
+  ((arena_block_t *)ptr - 1)->size |= BLOCK_FREED;
+  // Give back the top block and any freed ones directly under it
+  while (last != ARENA_NONE && (blockAt(last)->size & BLOCK_FREED)) {
+    top = last;
+    last = blockAt(last)->prev;
+  }
+  ARENA_UNLOCK();
+}
+
+bool arenaOwns(const void *ptr)
+{
+  const uint8_t *p = ptr;
+  return p >= arenaMemory && p < arenaMemory + sizeof(arenaMemory);
+}
+
+void arenaReset(void)
+{
+  ARENA_LOCK();
+  top = 0;
+  last = ARENA_NONE;
+  ARENA_UNLOCK();
+}
+
+size_t arenaCapacity(void)
+{
+  return sizeof(arenaMemory);
+}
+
+size_t arenaUsed(void)
+{
+  return top;
+}
+
+size_t arenaHighWater(void)
+{
+  return highWater;
+}
@@ -0,0 +1,70 @@
+#include "battery.h"
+
+#if CONFIG_BATTERY_MONITOR
+
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_idf_version.h"
+#include "esp_log.h"
+
+#define BATTERY_CHANNEL ((adc_channel_t)CONFIG_BATTERY_ADC_CHANNEL)
+#define BATTERY_SAMPLES 8
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0)
+#define BATTERY_ATTEN ADC_ATTEN_DB_12
+#else
+#define BATTERY_ATTEN ADC_ATTEN_DB_11
+#endif
+// Full scale at this attenuation, only used when the chip has no calibration eFuses
+#define BATTERY_FULL_SCALE_MV 3100
+
+uint16_t batteryReadMv(void)
+{
+  adc_oneshot_unit_handle_t unit;
+  const adc_oneshot_unit_init_cfg_t unitCfg = {.unit_id = ADC_UNIT_1};
+  if (adc_oneshot_new_unit(&unitCfg, &unit) != ESP_OK) {
+    ESP_LOGW("BATTERY", "ADC unavailable");
+    return 0;
+  }
+  const adc_oneshot_chan_cfg_t chanCfg = {
+      .atten = BATTERY_ATTEN,
+      .bitwidth = ADC_BITWIDTH_12,
+  };
+  adc_oneshot_config_channel(unit, BATTERY_CHANNEL, &chanCfg);
+
+  adc_cali_handle_t cali = NULL;
+  const adc_cali_line_fitting_config_t caliCfg = {
+      .unit_id = ADC_UNIT_1,
+      .atten = BATTERY_ATTEN,
+      .bitwidth = ADC_BITWIDTH_12,
+  };
+  if (adc_cali_create_scheme_line_fitting(&caliCfg, &cali) != ESP_OK) {
+    cali = NULL;
+  }
+
+  int32_t sum = 0;
+  int samples = 0;
+  for (int i = 0; i < BATTERY_SAMPLES; i++) {
+    int value;
+    esp_err_t err = cali ? adc_oneshot_get_calibrated_result(unit, cali, BATTERY_CHANNEL, &value)
+                         : adc_oneshot_read(unit, BATTERY_CHANNEL, &value);
+    if (err == ESP_OK) {
+      sum += cali ? value : value * BATTERY_FULL_SCALE_MV / 4095;
+      samples++;
+    }
+  }
+
+  if (cali) {
+    adc_cali_delete_scheme_line_fitting(cali);
+  }
+  adc_oneshot_del_unit(unit);
+
+  if (!samples) {
+    ESP_LOGW("BATTERY", "no ADC samples");
+    return 0;
+  }
+  uint32_t mv = (uint32_t)(sum / samples) * CONFIG_BATTERY_DIVIDER_PERCENT / 100;
+  return mv > UINT16_MAX ? UINT16_MAX : (uint16_t)mv;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include "cbor.h"
+
+#include <string.h>
+
+#define CBOR_UINT 0
+#define CBOR_NEGINT 1
+#define CBOR_BYTES 2
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+
+void cborInit(cbor_writer_t *w, uint8_t *buf, size_t size)
+{
+  *w = (cbor_writer_t){.buf = buf, .size = size};
+}
+
+static void append(cbor_writer_t *w, const void *data, size_t len)
+{
+  if (w->overflow || w->len + len > w->size) {
+    w->overflow = true;
+    return;
+  }
+  memcpy(w->buf + w->len, data, len);
+  w->len += len;
+}
+
+// Initial byte plus the shortest big-endian argument that holds value
+static void head(cbor_writer_t *w, uint8_t major, uint64_t value)
+{
+  uint8_t out[9];
+  size_t len;
+  if (value < 24) {
+    out[0] = (major << 5) | value;
+    len = 1;
+  } else {
+    int bytes = value <= UINT8_MAX ? 1 : value <= UINT16_MAX ? 2 : value <= UINT32_MAX ? 4 : 8;
+    out[0] = (major << 5) | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27);
+    for (int i = 0; i < bytes; i++) {
+      out[bytes - i] = value >> (8 * i);
+    }
+    len = bytes + 1;
+  }
+  append(w, out, len);
+}
+
+void cborUint(cbor_writer_t *w, uint64_t value)
+{
+  head(w, CBOR_UINT, value);
+}
+
+void cborInt(cbor_writer_t *w, int64_t value)
+{
+  if (value < 0) {
+    // -1 - n, which can't overflow unlike -value
+    head(w, CBOR_NEGINT, (uint64_t)(-1 - value));
+  } else {
+    head(w, CBOR_UINT, value);
+  }
+}
+
+void cborBytes(cbor_writer_t *w, const void *data, size_t len)
+{
+  head(w, CBOR_BYTES, len);
+  append(w, data, len);
+}
+
+void cborArray(cbor_writer_t *w, size_t count)
+{
+  head(w, CBOR_ARRAY, count);
+}
+
+void cborMap(cbor_writer_t *w, size_t pairs)
+{
+  head(w, CBOR_MAP, pairs);
+}
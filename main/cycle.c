@@ -0,0 +1,135 @@
+#include "cycle.h"
+
+#include <sys/time.h>
+
+#include "driver/rtc_io.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "schedule.h"
+#include "sdkconfig.h"
+
+#define CYCLE_NVS_NAMESPACE "cycle"
+#define CYCLE_NVS_HASH_KEY "snaphash"
+
+RTC_DATA_ATTR rtc_state_t rtcState;
+
+// The RTC timer keeps ticking through deep sleep, so gettimeofday() is monotonic across wakes
+int64_t cycleNowUs(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void cycleNvsInit(void)
+{
+  static bool ready;
+  if (ready) {
+    return;
+  }
+  esp_err_t err = nvs_flash_init();
+  if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+    ESP_ERROR_CHECK(nvs_flash_erase());
+    err = nvs_flash_init();
+  }
+  ESP_ERROR_CHECK(err);
+  ready = true;
+}
+
+cycle_wake_t cycleInit(void)
+{
+  esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+  bool cold = cause == ESP_SLEEP_WAKEUP_UNDEFINED || rtcState.magic != RTC_STATE_MAGIC;
+
+  if (cold) {
+    rtcState = (rtc_state_t){
+        .magic = RTC_STATE_MAGIC,
+        .nextWakeUs = cycleNowUs(),
+    };
+
+    // The panel kept its image through the power cycle, so remember what's on it
+    cycleNvsInit();
+    nvs_handle_t nvs;
+    if (nvs_open(CYCLE_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+      nvs_get_u32(nvs, CYCLE_NVS_HASH_KEY, &rtcState.snapshotHash);
+      nvs_close(nvs);
+    }
+  }
+  rtcState.bootCount++;
+
+  cycle_wake_t wake = CYCLE_WAKE_TIMER;
+  if (cold) {
+    wake = CYCLE_WAKE_COLD;
+  } else if (cause == ESP_SLEEP_WAKEUP_EXT0) {
+    wake = CYCLE_WAKE_BUTTON;
+  }
+  static const char *const names[] = {"cold", "timer", "button"};
+  ESP_LOGI("CYCLE", "wake #%lu (%s)", (unsigned long)rtcState.bootCount, names[wake]);
+  return wake;
+}
+
+bool cycleRefreshDue(void)
+{
+  return rtcState.wifiFailures || rtcState.fetchFailures ||
+         cycleNowUs() + (int64_t)CONFIG_REFRESH_RETRY_SEC * 1000000 >= rtcState.nextWakeUs;
+}
+
+void cycleSetSnapshotHash(uint32_t hash)
+{
+  if (hash == rtcState.snapshotHash) {
+    return;
+  }
+  rtcState.snapshotHash = hash;
+
+  cycleNvsInit();
+  nvs_handle_t nvs;
+  if (nvs_open(CYCLE_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+    if (nvs_set_u32(nvs, CYCLE_NVS_HASH_KEY, hash) == ESP_OK) {
+      nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+  }
+}
+
+static void sleepUntil(int64_t next)
+{
+  int64_t now = cycleNowUs();
+  ESP_LOGI("CYCLE", "sleeping for %lld ms", (next - now) / 1000);
+  ESP_ERROR_CHECK(esp_sleep_enable_timer_wakeup(next > now ? next - now : 0));
+#if CONFIG_WAKE_BUTTON
+  // Active low, held up through deep sleep by the RTC pull-up
+  rtc_gpio_pullup_en(CONFIG_WAKE_BUTTON_GPIO);
+  rtc_gpio_pulldown_dis(CONFIG_WAKE_BUTTON_GPIO);
+  ESP_ERROR_CHECK(esp_sleep_enable_ext0_wakeup(CONFIG_WAKE_BUTTON_GPIO, 0));
+#endif
+  esp_deep_sleep_start();
+}
+
+void cycleSleep(void)
+{
+#if CONFIG_HIL_BENCH
+  // Fixed length runs at a fixed cadence, so one build's numbers line up with the next's
+  if (rtcState.bootCount >= CONFIG_HIL_CYCLES) {
+    ESP_LOGI("CYCLE", "benchmark run done, sleeping until reset");
+    esp_deep_sleep_start();
+  }
+  rtcState.nextWakeUs = cycleNowUs() + (int64_t)CONFIG_HIL_SLEEP_SEC * 1000000;
+  sleepUntil(rtcState.nextWakeUs);
+#else
+  schedule_mode_t mode = SCHEDULE_NORMAL;
+  if (rtcState.wifiFailures || rtcState.fetchFailures) {
+    mode = rtcState.offline ? SCHEDULE_OFFLINE : SCHEDULE_RETRY;
+  }
+  int64_t next = scheduleNextWake(cycleNowUs(), rtcState.nextWakeUs, mode);
+  rtcState.nextWakeUs = next;
+  sleepUntil(next);
+#endif
+}
+
+void cycleResume(void)
+{
+  sleepUntil(rtcState.nextWakeUs);
+}
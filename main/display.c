@@ -0,0 +1,77 @@
+#include "display.h"
+
+#include <string.h>
+
+#include "cycle.h"
+#include "epd.h"
+#include "esp_log.h"
+#include "frameStore.h"
+#include "sdkconfig.h"
+
+#if CONFIG_EPD_PARTIAL_REFRESH
+// fbPrevious() holds what's on the panel
+static bool havePrevious;
+#endif
+
+framebuffer_t *displayFrame(bool restore, bool *current)
+{
+  framebuffer_t *fb = fbMain();
+  *current = false;
+
+#if CONFIG_EPD_PARTIAL_REFRESH
+  framebuffer_t *prev = fbPrevious();
+  havePrevious = restore && frameStoreLoad(prev);
+  if (havePrevious) {
+    for (int p = 0; p < FB_PLANES; p++) {
+      memcpy(fb->planes[p], prev->planes[p], FB_PLANE_SIZE);
+    }
+    *current = true;
+    return fb;
+  }
+#endif
+
+  fbClear(fb, FB_WHITE);
+  return fb;
+}
+
+esp_err_t displayShow(const framebuffer_t *fb, const fb_rect_t *dirty)
+{
+#if CONFIG_EPD_PARTIAL_REFRESH
+  // The widgets that were redrawn can still come out pixel for pixel what the panel shows, so
+  // refresh only what really changed (on byte boundaries for the controller's window)
+  fb_rect_t changed;
+  if (havePrevious) {
+    if (!fbDiff(fb, fbPrevious(), &changed)) {
+      ESP_LOGI("DISPLAY", "frame unchanged");
+      return ESP_OK;
+    }
+    int x1 = (changed.x + changed.w + 7) & ~7;
+    changed.x &= ~7;
+    changed.w = x1 - changed.x;
+    dirty = &changed;
+  }
+
+  // Past a certain size a partial refresh isn't any quicker and ghosts more
+  bool partial = havePrevious && rtcState.partialRefreshes < CONFIG_EPD_FULL_REFRESH_EVERY &&
+                 (int32_t)dirty->w * dirty->h <=
+                     (int32_t)FB_WIDTH * FB_HEIGHT * CONFIG_EPD_PARTIAL_MAX_PERCENT / 100;
+
+  esp_err_t err;
+  if (partial) {
+    ESP_LOGI("DISPLAY", "partial refresh %dx%d at %d,%d", dirty->w, dirty->h, dirty->x, dirty->y);
+    err = epdDisplayPartial(fb, fbPrevious(), dirty);
+  } else {
+    ESP_LOGI("DISPLAY", "full refresh");
+    err = epdDisplay(fb);
+  }
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  rtcState.partialRefreshes = partial ? rtcState.partialRefreshes + 1 : 0;
+  frameStoreSave(fb, havePrevious ? fbPrevious() : NULL);
+  return ESP_OK;
+#else
+  return epdDisplay(fb);
+#endif
+}
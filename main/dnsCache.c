@@ -0,0 +1,239 @@
+#include "dnsCache.h"
+
+#include <string.h>
+
+#include "cycle.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "hash.h"
+#include "lwip/dns.h"
+#include "lwip/inet.h"
+#include "lwip/tcpip.h"
+#include "netIo.h"
+#include "sdkconfig.h"
+
+#define DNS_TTL_US ((int64_t)CONFIG_DNS_CACHE_TTL_SEC * 1000000)
+// Nobody waits on a background refresh, but it shouldn't hang about either
+#define DNS_REFRESH_TIMEOUT_MS 5000
+
+typedef struct {
+  uint32_t hostHash;  // 0 = empty slot
+  uint32_t addr;      // Network byte order
+  int64_t resolvedUs; // cycleNowUs() of the lookup
+} dns_entry_t;
+
+// Survives deep sleep, a cold boot starts with an empty cache
+RTC_DATA_ATTR static dns_entry_t dnsCache[CONFIG_DNS_CACHE_ENTRIES];
+
+// Background refreshes write entries while the fetch path reads them
+static portMUX_TYPE dnsLock = portMUX_INITIALIZER_UNLOCKED;
+static bool refreshRunning = false;
+static bool fallbackSet = false;
+
+// The lookup in flight. One at a time, and a lookup that timed out can still answer late, so
+// answers only count if they carry the current generation.
+static struct {
+  const char *host;
+  uint32_t generation;
+  uint32_t addr;  // Network byte order, 0 if it failed
+} query;
+static StaticSemaphore_t queryLockBuf;
+static SemaphoreHandle_t queryLock;
+static StaticSemaphore_t queryDoneBuf;
+static SemaphoreHandle_t queryDone;
+
+static uint32_t hostHash(const char *host)
+{
+  uint32_t hash = fnv1a(FNV1A_INIT, host, strlen(host));
+  return hash ? hash : 1;
+}
+
+static dns_entry_t *findEntry(uint32_t hash)
+{
+  for (int i = 0; i < CONFIG_DNS_CACHE_ENTRIES; i++) {
+    if (dnsCache[i].hostHash == hash) {
+      return &dnsCache[i];
+    }
+  }
+  return NULL;
+}
+
+static void storeEntry(uint32_t hash, uint32_t addr)
+{
+  portENTER_CRITICAL(&dnsLock);
+  dns_entry_t *entry = findEntry(hash);
+  if (!entry) {
+    // Replace the oldest slot
+    entry = &dnsCache[0];
+    for (int i = 1; i < CONFIG_DNS_CACHE_ENTRIES; i++) {
+      if (dnsCache[i].resolvedUs < entry->resolvedUs) {
+        entry = &dnsCache[i];
+      }
+    }
+  }
+  *entry = (dns_entry_t){
+      .hostHash = hash,
+      .addr = addr,
+      .resolvedUs = cycleNowUs(),
+  };
+  portEXIT_CRITICAL(&dnsLock);
+}
+
+// Add the Kconfig fallback as the backup server, the DHCP server only hands out one on most
+// home routers and lwIP moves on to the next server when the first one times out
+static void setFallbackServer(void)
+{
+  if (fallbackSet || CONFIG_DNS_FALLBACK_SERVER[0] == '\0') {
+    return;
+  }
+  esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+  if (!netif) {
+    return;
+  }
+
+  esp_netif_dns_info_t dnsInfo = {0};
+  dnsInfo.ip.type = ESP_IPADDR_TYPE_V4;
+  dnsInfo.ip.u_addr.ip4.addr = ipaddr_addr(CONFIG_DNS_FALLBACK_SERVER);
+  if (esp_netif_set_dns_info(netif, ESP_NETIF_DNS_BACKUP, &dnsInfo) == ESP_OK) {
+    fallbackSet = true;
+  }
+}
+
+// lwIP callbacks run on the tcpip thread
+static void onFound(const char *name, const ip_addr_t *ip, void *arg)
+{
+  portENTER_CRITICAL(&dnsLock);
+  bool current = (uint32_t)(uintptr_t)arg == query.generation;
+  if (current) {
+    query.addr = ip && IP_IS_V4(ip) ? ip_2_ip4(ip)->addr : 0;
+  }
+  portEXIT_CRITICAL(&dnsLock);
+  if (current) {
+    xSemaphoreGive(queryDone);
+  }
+}
+
+static void startQuery(void *arg)
+{
+  ip_addr_t ip;
+  err_t err = dns_gethostbyname(query.host, &ip, onFound, arg);
+  if (err == ERR_OK) {
+    // An address literal, or already in lwIP's own cache
+    onFound(query.host, &ip, arg);
+  } else if (err != ERR_INPROGRESS) {
+    onFound(query.host, NULL, arg);
+  }
+}
+
+static TickType_t ticksLeft(int64_t deadlineUs)
+{
+  int64_t left = deadlineUs - esp_timer_get_time();
+  return left > 0 ? pdMS_TO_TICKS((left + 999) / 1000) : 0;
+}
+
+// getaddrinfo() blocks through every one of lwIP's retries, this gives up at the deadline
+static esp_err_t lookup(const char *host, uint32_t *addr, int64_t deadlineUs)
+{
+  portENTER_CRITICAL(&dnsLock);
+  if (!queryLock) {
+    queryLock = xSemaphoreCreateMutexStatic(&queryLockBuf);
+    queryDone = xSemaphoreCreateBinaryStatic(&queryDoneBuf);
+  }
+  portEXIT_CRITICAL(&dnsLock);
+
+  setFallbackServer();
+  if (xSemaphoreTake(queryLock, ticksLeft(deadlineUs)) != pdTRUE) {
+    ESP_LOGE("DNS", "lookup of %s timed out waiting for another", host);
+    return ESP_ERR_TIMEOUT;
+  }
+  portENTER_CRITICAL(&dnsLock);
+  query.host = host;
+  query.addr = 0;
+  uint32_t generation = ++query.generation;
+  portEXIT_CRITICAL(&dnsLock);
+  // A late answer to the last lookup may have been given just before the generation moved on
+  xSemaphoreTake(queryDone, 0);
+
+  esp_err_t err = ESP_FAIL;
+  if (tcpip_callback(startQuery, (void *)(uintptr_t)generation) != ERR_OK) {
+    ESP_LOGE("DNS", "lookup of %s not started", host);
+  } else if (xSemaphoreTake(queryDone, ticksLeft(deadlineUs)) != pdTRUE) {
+    ESP_LOGE("DNS", "lookup of %s timed out", host);
+    err = ESP_ERR_TIMEOUT;
+  } else if (!query.addr) {
+    ESP_LOGE("DNS", "lookup of %s failed", host);
+  } else {
+    *addr = query.addr;
+    err = ESP_OK;
+  }
+
+  // Whatever answers from here on is too late
+  portENTER_CRITICAL(&dnsLock);
+  query.generation++;
+  portEXIT_CRITICAL(&dnsLock);
+  xSemaphoreGive(queryLock);
+  return err;
+}
+
+static void refreshTask(void *arg)
+{
+  const char *host = arg;
+  uint32_t addr;
+  if (lookup(host, &addr, netDeadline(DNS_REFRESH_TIMEOUT_MS)) == ESP_OK) {
+    storeEntry(hostHash(host), addr);
+    ESP_LOGI("DNS", "refreshed %s", host);
+  }
+  refreshRunning = false;
+  vTaskDelete(NULL);
+}
+
+esp_err_t dnsResolve(const char *host, struct in_addr *addr, bool *cached, int64_t deadlineUs)
+{
+  uint32_t hash = hostHash(host);
+
+  portENTER_CRITICAL(&dnsLock);
+  dns_entry_t *entry = findEntry(hash);
+  dns_entry_t copy = entry ? *entry : (dns_entry_t){0};
+  portEXIT_CRITICAL(&dnsLock);
+
+  if (cached) {
+    *cached = entry != NULL;
+  }
+  if (entry) {
+    addr->s_addr = copy.addr;
+
+    // Stale: use it anyway and refresh behind the caller's back. host has to outlive the task,
+    // which it does since it's always a Kconfig string.
+    if (cycleNowUs() - copy.resolvedUs >= DNS_TTL_US && !refreshRunning) {
+      refreshRunning = true;
+      if (xTaskCreate(refreshTask, "dns_refresh", 3072, (void *)host, 2, NULL) != pdPASS) {
+        refreshRunning = false;
+      }
+    }
+    return ESP_OK;
+  }
+
+  uint32_t resolved;
+  esp_err_t err = lookup(host, &resolved, deadlineUs);
+  if (err != ESP_OK) {
+    return err;
+  }
+  storeEntry(hash, resolved);
+  addr->s_addr = resolved;
+  return ESP_OK;
+}
+
+void dnsInvalidate(const char *host)
+{
+  portENTER_CRITICAL(&dnsLock);
+  dns_entry_t *entry = findEntry(hostHash(host));
+  if (entry) {
+    memset(entry, 0, sizeof(*entry));
+  }
+  portEXIT_CRITICAL(&dnsLock);
+}
@@ -0,0 +1,386 @@
+#include "epd.h"
+
+#include <string.h>
+
+#include "driver/gpio.h"
+#include "driver/spi_master.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "probe.h"
+#include "sdkconfig.h"
+
+#define EPD_HOST SPI2_HOST
+#define EPD_CHUNK CONFIG_EPD_DMA_CHUNK
+// Data transactions in flight at once, one being clocked out while the next is queued
+#define EPD_QUEUE_DEPTH 2
+
+// UC8179 commands
+#define CMD_PANEL_SETTING 0x00
+#define CMD_POWER_SETTING 0x01
+#define CMD_POWER_OFF 0x02
+#define CMD_POWER_ON 0x04
+#define CMD_DEEP_SLEEP 0x07
+#define CMD_DATA_START_OLD 0x10  // DTM1
+#define CMD_DISPLAY_REFRESH 0x12
+#define CMD_DATA_START_NEW 0x13  // DTM2
+#define CMD_DUAL_SPI 0x15
+#define CMD_VCOM_INTERVAL 0x50
+#define CMD_TCON 0x60
+#define CMD_RESOLUTION 0x61
+#define CMD_PARTIAL_WINDOW 0x90
+#define CMD_PARTIAL_IN 0x91
+#define CMD_PARTIAL_OUT 0x92
+#define CMD_CASCADE 0xE0
+#define CMD_FORCE_TEMP 0xE5
+
+static spi_device_handle_t spi;
+static SemaphoreHandle_t busySem;
+static bool panelAwake = false;
+
+// D/C has to flip between the command byte and its parameters, the level rides along in the
+// transaction's user field
+static void IRAM_ATTR preTransfer(spi_transaction_t *t)
+{
+  gpio_set_level(CONFIG_EPD_PIN_DC, (int)(intptr_t)t->user);
+}
+
+// BUSY goes high when the controller is done
+static void IRAM_ATTR busyIsr(void *arg)
+{
+  BaseType_t woken = pdFALSE;
+  xSemaphoreGiveFromISR(busySem, &woken);
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+static esp_err_t waitBusy(uint32_t timeoutMs)
+{
+  xSemaphoreTake(busySem, 0);
+  gpio_intr_enable(CONFIG_EPD_PIN_BUSY);
+  // It may already have gone idle before the interrupt was armed
+  bool idle = gpio_get_level(CONFIG_EPD_PIN_BUSY) ||
+              xSemaphoreTake(busySem, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+  gpio_intr_disable(CONFIG_EPD_PIN_BUSY);
+
+  if (!idle) {
+    ESP_LOGE("EPD", "panel stuck busy");
+    return ESP_ERR_TIMEOUT;
+  }
+  return ESP_OK;
+}
+
+// Command byte plus (short) parameter bytes, two small transactions
+static esp_err_t sendCommand(uint8_t cmd, const uint8_t *data, size_t len)
+{
+  spi_transaction_t t = {
+      .length = 8,
+      .tx_data = {cmd},
+      .flags = SPI_TRANS_USE_TXDATA,
+      .user = (void *)0,
+  };
+  esp_err_t err = spi_device_polling_transmit(spi, &t);
+  if (err != ESP_OK || len == 0) {
+    return err;
+  }
+
+  t = (spi_transaction_t){
+      .length = len * 8,
+      .user = (void *)1,
+  };
+  if (len <= 4) {
+    t.flags = SPI_TRANS_USE_TXDATA;
+    memcpy(t.tx_data, data, len);
+  } else {
+    t.tx_buffer = data;
+  }
+  return spi_device_polling_transmit(spi, &t);
+}
+
+// Data transactions are queued back to back, EPD_QUEUE_DEPTH in flight, so the bus never idles
+// waiting on us and the task sleeps in the SPI driver in between
+static spi_transaction_t trans[EPD_QUEUE_DEPTH];
+static size_t queued;
+static size_t inFlight;
+
+#if CONFIG_EPD_PARTIAL_REFRESH
+// Partial windows aren't contiguous in the framebuffer, their rows are gathered into these.
+// One is filled while the other is on the wire.
+DMA_ATTR static uint8_t staging[EPD_QUEUE_DEPTH][EPD_CHUNK];
+#endif
+
+// Wait for the oldest transaction so its slot can be reused
+static esp_err_t reclaimSlot(void)
+{
+  spi_transaction_t *done;
+  esp_err_t err = spi_device_get_trans_result(spi, &done, portMAX_DELAY);
+  if (err == ESP_OK) {
+    inFlight--;
+  }
+  return err;
+}
+
+static esp_err_t drainQueue(void)
+{
+  while (inFlight) {
+    esp_err_t err = reclaimSlot();
+    if (err != ESP_OK) {
+      return err;
+    }
+  }
+  return ESP_OK;
+}
+
+static esp_err_t queueData(const uint8_t *data, size_t len)
+{
+  if (inFlight == EPD_QUEUE_DEPTH) {
+    esp_err_t err = reclaimSlot();
+    if (err != ESP_OK) {
+      return err;
+    }
+  }
+
+  spi_transaction_t *t = &trans[queued % EPD_QUEUE_DEPTH];
+  *t = (spi_transaction_t){
+      .length = len * 8,
+      .tx_buffer = data,
+      .user = (void *)1,
+  };
+  esp_err_t err = spi_device_queue_trans(spi, t, portMAX_DELAY);
+  if (err == ESP_OK) {
+    queued++;
+    inFlight++;
+  }
+  return err;
+}
+
+// Stream a whole plane after its data-start command, chunks DMA straight out of the framebuffer
+static esp_err_t sendPlane(uint8_t cmd, const uint8_t *data, size_t len)
+{
+  probeBegin(PROBE_SPI);
+  esp_err_t err = sendCommand(cmd, NULL, 0);
+
+  for (size_t ofs = 0; ofs < len && err == ESP_OK; ofs += EPD_CHUNK) {
+    err = queueData(data + ofs, len - ofs < EPD_CHUNK ? len - ofs : EPD_CHUNK);
+  }
+
+  esp_err_t drained = drainQueue();
+  probeEnd(PROBE_SPI);
+  return err != ESP_OK ? err : drained;
+}
+
+#if CONFIG_EPD_PARTIAL_REFRESH
+// Stream just the rows/bytes of a plane inside a (byte aligned) window
+static esp_err_t sendWindow(uint8_t cmd, const uint8_t *plane, const fb_rect_t *rect)
+{
+  size_t rowBytes = rect->w / 8;
+  size_t rowsPerChunk = EPD_CHUNK / rowBytes;
+  const uint8_t *src = plane + (size_t)rect->y * FB_STRIDE + rect->x / 8;
+
+  probeBegin(PROBE_SPI);
+  esp_err_t err = sendCommand(cmd, NULL, 0);
+
+  for (int row = 0; row < rect->h && err == ESP_OK;) {
+    // This slot's staging buffer may still be on the wire
+    if (inFlight == EPD_QUEUE_DEPTH) {
+      err = reclaimSlot();
+      if (err != ESP_OK) {
+        break;
+      }
+    }
+    uint8_t *buf = staging[queued % EPD_QUEUE_DEPTH];
+
+    size_t rows = rect->h - row < rowsPerChunk ? rect->h - row : rowsPerChunk;
+    for (size_t i = 0; i < rows; i++, row++) {
+      memcpy(buf + i * rowBytes, src + (size_t)row * FB_STRIDE, rowBytes);
+    }
+    err = queueData(buf, rows * rowBytes);
+  }
+
+  esp_err_t drained = drainQueue();
+  probeEnd(PROBE_SPI);
+  return err != ESP_OK ? err : drained;
+}
+#endif
+
+static void reset(void)
+{
+  gpio_set_level(CONFIG_EPD_PIN_RST, 1);
+  vTaskDelay(pdMS_TO_TICKS(20));
+  gpio_set_level(CONFIG_EPD_PIN_RST, 0);
+  vTaskDelay(pdMS_TO_TICKS(2));
+  gpio_set_level(CONFIG_EPD_PIN_RST, 1);
+  vTaskDelay(pdMS_TO_TICKS(20));
+}
+
+// Reset out of deep sleep and run the power on sequence
+static esp_err_t wake(bool partial)
+{
+  if (panelAwake) {
+    return ESP_OK;
+  }
+  reset();
+
+  static const uint8_t power[] = {0x07, 0x07, 0x3F, 0x3F};  // VGH/VGL 20V, VDH/VDL 15V
+  static const uint8_t panel[] = {0x1F};                    // KW mode, LUT from OTP
+  static const uint8_t resolution[] = {FB_WIDTH >> 8, FB_WIDTH & 0xFF, FB_HEIGHT >> 8,
+                                       FB_HEIGHT & 0xFF};
+  static const uint8_t dualSpi[] = {0x00};
+  // Partial updates drive the border floating and compare old/new data (DTM1/DTM2)
+  static const uint8_t vcomFull[] = {0x10, 0x07};
+  static const uint8_t vcomPartial[] = {0xA9, 0x07};
+  static const uint8_t tcon[] = {0x22};
+
+  sendCommand(CMD_POWER_SETTING, power, sizeof(power));
+  sendCommand(CMD_POWER_ON, NULL, 0);
+  vTaskDelay(pdMS_TO_TICKS(100));
+  esp_err_t err = waitBusy(1000);
+  if (err != ESP_OK) {
+    return err;
+  }
+  sendCommand(CMD_PANEL_SETTING, panel, sizeof(panel));
+  sendCommand(CMD_RESOLUTION, resolution, sizeof(resolution));
+  sendCommand(CMD_DUAL_SPI, dualSpi, sizeof(dualSpi));
+  sendCommand(CMD_VCOM_INTERVAL, partial ? vcomPartial : vcomFull, sizeof(vcomFull));
+  sendCommand(CMD_TCON, tcon, sizeof(tcon));
+#if FB_PLANES == 2
+  // The OTP keeps a 4 grey waveform next to the black and white one, picked by a forced
+  // temperature reading (TSFIX) in the slot it lives in
+  static const uint8_t cascade[] = {0x02};
+  static const uint8_t forceTemp[] = {0x5F};
+  sendCommand(CMD_CASCADE, cascade, sizeof(cascade));
+  sendCommand(CMD_FORCE_TEMP, forceTemp, sizeof(forceTemp));
+#endif
+
+  panelAwake = true;
+  return ESP_OK;
+}
+
+esp_err_t epdInit(void)
+{
+  const spi_bus_config_t buscfg = {
+      .mosi_io_num = CONFIG_EPD_PIN_MOSI,
+      .miso_io_num = -1,
+      .sclk_io_num = CONFIG_EPD_PIN_SCLK,
+      .quadwp_io_num = -1,
+      .quadhd_io_num = -1,
+      .max_transfer_sz = EPD_CHUNK,
+  };
+  ESP_ERROR_CHECK(spi_bus_initialize(EPD_HOST, &buscfg, SPI_DMA_CH_AUTO));
+
+  const spi_device_interface_config_t devcfg = {
+      .clock_speed_hz = CONFIG_EPD_SPI_CLOCK_HZ,
+      .mode = 0,
+      .spics_io_num = CONFIG_EPD_PIN_CS,
+      .queue_size = EPD_QUEUE_DEPTH,
+      .pre_cb = preTransfer,
+  };
+  ESP_ERROR_CHECK(spi_bus_add_device(EPD_HOST, &devcfg, &spi));
+
+  const gpio_config_t outputs = {
+      .pin_bit_mask = (1ULL << CONFIG_EPD_PIN_DC) | (1ULL << CONFIG_EPD_PIN_RST),
+      .mode = GPIO_MODE_OUTPUT,
+  };
+  ESP_ERROR_CHECK(gpio_config(&outputs));
+
+  const gpio_config_t busy = {
+      .pin_bit_mask = 1ULL << CONFIG_EPD_PIN_BUSY,
+      .mode = GPIO_MODE_INPUT,
+      .intr_type = GPIO_INTR_POSEDGE,
+  };
+  ESP_ERROR_CHECK(gpio_config(&busy));
+
+  busySem = xSemaphoreCreateBinary();
+  esp_err_t err = gpio_install_isr_service(0);
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {  // Already installed is fine
+    return err;
+  }
+  ESP_ERROR_CHECK(gpio_isr_handler_add(CONFIG_EPD_PIN_BUSY, busyIsr, NULL));
+  gpio_intr_disable(CONFIG_EPD_PIN_BUSY);
+
+  return ESP_OK;
+}
+
+esp_err_t epdDisplay(const framebuffer_t *fb)
+{
+  esp_err_t err = wake(false);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+#if FB_PLANES == 2
+  // Under the grey waveform DTM1 is set for light grey and black and DTM2 for dark grey and
+  // black, which is exactly bit 0 and bit 1 of the level, so each plane goes as it is
+  err = sendPlane(CMD_DATA_START_OLD, fb->planes[0], FB_PLANE_SIZE);
+  if (err == ESP_OK) {
+    err = sendPlane(CMD_DATA_START_NEW, fb->planes[1], FB_PLANE_SIZE);
+  }
+#else
+  err = sendPlane(CMD_DATA_START_NEW, fb->planes[0], FB_PLANE_SIZE);
+#endif
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  sendCommand(CMD_DISPLAY_REFRESH, NULL, 0);
+  probeBegin(PROBE_BUSY);
+  vTaskDelay(pdMS_TO_TICKS(100));
+  // A full refresh takes a few seconds, the task blocks on the BUSY interrupt meanwhile
+  err = waitBusy(CONFIG_EPD_REFRESH_TIMEOUT_MS);
+  probeEnd(PROBE_BUSY);
+
+  epdSleep();
+  return err;
+}
+
+#if CONFIG_EPD_PARTIAL_REFRESH
+esp_err_t epdDisplayPartial(const framebuffer_t *fb, const framebuffer_t *prev,
+                            const fb_rect_t *rect)
+{
+  esp_err_t err = wake(true);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  // Window ends are inclusive, horizontal ones on byte boundaries
+  uint16_t x0 = rect->x, x1 = rect->x + rect->w - 1;
+  uint16_t y0 = rect->y, y1 = rect->y + rect->h - 1;
+  const uint8_t window[] = {x0 >> 8, x0 & 0xF8, x1 >> 8, (x1 & 0xFF) | 0x07, y0 >> 8, y0 & 0xFF,
+                            y1 >> 8, y1 & 0xFF, 0x01};
+
+  sendCommand(CMD_PARTIAL_IN, NULL, 0);
+  sendCommand(CMD_PARTIAL_WINDOW, window, sizeof(window));
+  // The controller lost its RAM in deep sleep, so give it the old image too
+  err = sendWindow(CMD_DATA_START_OLD, prev->planes[0], rect);
+  if (err == ESP_OK) {
+    err = sendWindow(CMD_DATA_START_NEW, fb->planes[0], rect);
+  }
+  if (err == ESP_OK) {
+    sendCommand(CMD_DISPLAY_REFRESH, NULL, 0);
+    probeBegin(PROBE_BUSY);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    err = waitBusy(CONFIG_EPD_REFRESH_TIMEOUT_MS);
+    probeEnd(PROBE_BUSY);
+  }
+  sendCommand(CMD_PARTIAL_OUT, NULL, 0);
+
+  epdSleep();
+  return err;
+}
+#endif
+
+void epdSleep(void)
+{
+  if (!panelAwake) {
+    return;
+  }
+  static const uint8_t check[] = {0xA5};
+
+  sendCommand(CMD_POWER_OFF, NULL, 0);
+  waitBusy(1000);
+  sendCommand(CMD_DEEP_SLEEP, check, sizeof(check));
+  panelAwake = false;
+}
@@ -0,0 +1,77 @@
+#include "forecastCache.h"
+
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+#include "snapshotAdvance.h"
+#include "snapshotCodec.h"
+
+#define FORECAST_NVS_NAMESPACE "forecast"
+#define FORECAST_NVS_HEAD_KEY "head"
+#define FORECAST_KEY_LEN 8
+
+// Not bound by an ESP-NOW frame here. Sized for the worst case varints, so no hourly entries
+// are ever dropped.
+#define FORECAST_RECORD_MAX (40 + 6 * WEATHER_HOURLY_MAX + 8 * WEATHER_DAILY_MAX)
+
+static void recordKey(char *key, unsigned slot)
+{
+  snprintf(key, FORECAST_KEY_LEN, "s%u", slot);
+}
+
+void forecastCacheSave(const weather_snapshot_t *snap)
+{
+  static uint8_t buf[FORECAST_RECORD_MAX];
+  size_t len = snapshotEncode(snap, 0, buf, sizeof(buf));
+  if (!len) {
+    return;
+  }
+
+  nvs_handle_t nvs;
+  if (nvs_open(FORECAST_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+    return;
+  }
+  // head is the slot written last
+  uint8_t head = 0;
+  nvs_get_u8(nvs, FORECAST_NVS_HEAD_KEY, &head);
+  head = (head + 1) % CONFIG_FORECAST_CACHE_COUNT;
+
+  char key[FORECAST_KEY_LEN];
+  recordKey(key, head);
+  if (nvs_set_blob(nvs, key, buf, len) == ESP_OK &&
+      nvs_set_u8(nvs, FORECAST_NVS_HEAD_KEY, head) == ESP_OK) {
+    nvs_commit(nvs);
+  }
+  nvs_close(nvs);
+}
+
+bool forecastCacheLoad(uint32_t now, weather_snapshot_t *out)
+{
+  nvs_handle_t nvs;
+  if (nvs_open(FORECAST_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+    return false;
+  }
+  uint8_t head = 0;
+  nvs_get_u8(nvs, FORECAST_NVS_HEAD_KEY, &head);
+
+  // Newest first, an older forecast reaches no further than a newer one did
+  static uint8_t buf[FORECAST_RECORD_MAX];
+  static weather_snapshot_t kept;
+  bool found = false;
+  for (unsigned i = 0; i < CONFIG_FORECAST_CACHE_COUNT && !found; i++) {
+    char key[FORECAST_KEY_LEN];
+    recordKey(key, (head + CONFIG_FORECAST_CACHE_COUNT - i) % CONFIG_FORECAST_CACHE_COUNT);
+    size_t len = sizeof(buf);
+    uint8_t location;
+    found = nvs_get_blob(nvs, key, buf, &len) == ESP_OK &&
+            snapshotDecode(buf, len, &location, &kept) && snapshotAdvance(&kept, now, out);
+    if (found) {
+      ESP_LOGI("FORECAST", "kept forecast from %lu s ago (%s)",
+               (unsigned long)(now - kept.time), key);
+    }
+  }
+  nvs_close(nvs);
+  return found;
+}
@@ -0,0 +1,163 @@
+#include "frameCodec.h"
+
+#include <string.h>
+
+#define TOKEN_LITERAL_MAX 128
+#define TOKEN_RUN 0x80
+#define TOKEN_RUN_SHORT_MAX 64
+#define TOKEN_RUN_LONG 0xC0
+#define TOKEN_RUN_LONG_MAX (TOKEN_RUN_SHORT_MAX + 1 + 0x3FFF)
+
+// Output is collected here and handed over a piece at a time
+typedef struct {
+  uint8_t buf[256];
+  size_t used;
+  size_t total;
+  frame_sink_t sink;
+  void *ctx;
+} encoder_t;
+
+static void flush(encoder_t *e)
+{
+  if (e->sink && e->used) {
+    e->sink(e->ctx, e->buf, e->used);
+  }
+  e->used = 0;
+}
+
+static void put(encoder_t *e, const uint8_t *data, size_t len)
+{
+  if (e->used + len > sizeof(e->buf)) {
+    flush(e);
+  }
+  memcpy(e->buf + e->used, data, len);
+  e->used += len;
+  e->total += len;
+}
+
+static inline uint8_t byteAt(const uint8_t *plane, const uint8_t *ref, size_t i)
+{
+  return ref ? plane[i] ^ ref[i] : plane[i];
+}
+
+static inline uint32_t wordAt(const uint8_t *plane, const uint8_t *ref, size_t i)
+{
+  uint32_t v, r;
+  memcpy(&v, plane + i, sizeof(v));
+  if (ref) {
+    memcpy(&r, ref + i, sizeof(r));
+    v ^= r;
+  }
+  return v;
+}
+
+// Zero bytes from i on, a word at a time while that's possible
+static size_t zeroRun(const uint8_t *plane, const uint8_t *ref, size_t i, size_t n)
+{
+  size_t start = i;
+  while (i + 4 <= n && wordAt(plane, ref, i) == 0) {
+    i += 4;
+  }
+  while (i < n && byteAt(plane, ref, i) == 0) {
+    i++;
+  }
+  return i - start;
+}
+
+static void putRun(encoder_t *e, size_t run)
+{
+  while (run) {
+    size_t take = run < TOKEN_RUN_LONG_MAX ? run : TOKEN_RUN_LONG_MAX;
+    if (take <= TOKEN_RUN_SHORT_MAX) {
+      const uint8_t t = TOKEN_RUN | (take - 1);
+      put(e, &t, 1);
+    } else {
+      size_t v = take - TOKEN_RUN_SHORT_MAX - 1;
+      const uint8_t t[2] = {TOKEN_RUN_LONG | (v >> 8), v & 0xFF};
+      put(e, t, 2);
+    }
+    run -= take;
+  }
+}
+
+size_t frameEncode(const uint8_t *plane, const uint8_t *ref, size_t n, frame_sink_t sink,
+                   void *ctx)
+{
+  encoder_t e = {.sink = sink, .ctx = ctx};
+  size_t i = 0;
+  while (i < n) {
+    size_t run = zeroRun(plane, ref, i, n);
+    // A lone zero is cheaper left inside a literal
+    if (run >= 2 || i + run == n) {
+      putRun(&e, run);
+      i += run;
+      continue;
+    }
+
+    // Literal up to the next pair of zeros
+    uint8_t lit[1 + TOKEN_LITERAL_MAX];
+    size_t len = 0;
+    while (i < n && len < TOKEN_LITERAL_MAX) {
+      uint8_t b = byteAt(plane, ref, i);
+      if (b == 0 && i + 1 < n && byteAt(plane, ref, i + 1) == 0) {
+        break;
+      }
+      lit[1 + len++] = b;
+      i++;
+    }
+    lit[0] = len - 1;
+    put(&e, lit, 1 + len);
+  }
+  flush(&e);
+  return e.total;
+}
+
+size_t frameDecode(const uint8_t *in, size_t len, const uint8_t *ref, uint8_t *plane, size_t n)
+{
+  size_t pos = 0;
+  size_t out = 0;
+  while (out < n) {
+    if (pos >= len) {
+      return 0;
+    }
+    uint8_t t = in[pos++];
+
+    if (t < TOKEN_RUN) {
+      size_t count = (size_t)t + 1;
+      if (count > len - pos || count > n - out) {
+        return 0;
+      }
+      if (ref) {
+        for (size_t k = 0; k < count; k++) {
+          plane[out + k] = ref[out + k] ^ in[pos + k];
+        }
+      } else {
+        memcpy(plane + out, in + pos, count);
+      }
+      pos += count;
+      out += count;
+      continue;
+    }
+
+    size_t run;
+    if (t < TOKEN_RUN_LONG) {
+      run = (size_t)(t & 0x3F) + 1;
+    } else {
+      if (pos >= len) {
+        return 0;
+      }
+      run = ((size_t)(t & 0x3F) << 8 | in[pos++]) + TOKEN_RUN_SHORT_MAX + 1;
+    }
+    if (run > n - out) {
+      return 0;
+    }
+    // Nothing changed here, which in place means nothing to do at all
+    if (!ref) {
+      memset(plane + out, 0, run);
+    } else if (ref != plane) {
+      memcpy(plane + out, ref + out, run);
+    }
+    out += run;
+  }
+  return pos;
+}
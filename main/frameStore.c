@@ -0,0 +1,318 @@
+#include "frameStore.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "frameCodec.h"
+#include "sdkconfig.h"
+
+#define FRAME_PARTITION_SUBTYPE 0x40
+#define FRAME_MAGIC 0x46524D32  // "FRM2"
+#define FRAME_MAX_SECTORS 64
+
+#ifndef CONFIG_FRAME_KEY_EVERY
+#define CONFIG_FRAME_KEY_EVERY 8
+#endif
+
+// Frames are appended round the partition as compressed records, each starting on a sector
+// boundary, so every save erases the one or two sectors after the last record instead of the
+// whole 48 KB in the same place. The header goes down first: a save cut short leaves the newest
+// record failing its CRC, which reads as not knowing what's on the panel.
+typedef struct {
+  uint32_t magic;
+  uint32_t seq;    // One more every save, the highest is what's on the panel
+  uint32_t len;    // Payload after the header, FB_PLANES frameCodec streams back to back
+  uint32_t crc;    // CRC-32 of the payload
+  uint8_t delta;   // XOR against record seq - 1 rather than a blank frame
+  uint8_t planes;  // FB_PLANES
+  uint16_t chain;  // Records back to the full frame this one builds on, 0 for a full frame
+} frame_record_t;
+
+// What a scan found at the start of each sector
+typedef struct {
+  bool valid;
+  uint32_t seq;
+  uint8_t sectors;
+  frame_record_t header;
+} frame_slot_t;
+
+static const esp_partition_t *part;
+static size_t sectorCount;
+static frame_slot_t slots[FRAME_MAX_SECTORS];
+static bool scanned;
+static int newest = -1;  // Slot of the highest seq
+
+static const esp_partition_t *framePartition(void)
+{
+  if (!part) {
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, FRAME_PARTITION_SUBTYPE, "frame");
+    if (!part) {
+      ESP_LOGE("FRAME", "no frame partition");
+    } else {
+      sectorCount = part->size / part->erase_size;
+      if (sectorCount > FRAME_MAX_SECTORS) {
+        sectorCount = FRAME_MAX_SECTORS;
+      }
+    }
+  }
+  return part;
+}
+
+static size_t recordSectors(uint32_t len)
+{
+  return (sizeof(frame_record_t) + len + part->erase_size - 1) / part->erase_size;
+}
+
+static void scan(const uint8_t *flash)
+{
+  newest = -1;
+  for (size_t s = 0; s < sectorCount; s++) {
+    frame_slot_t *slot = &slots[s];
+    memcpy(&slot->header, flash + s * part->erase_size, sizeof(slot->header));
+    const frame_record_t *h = &slot->header;
+    slot->valid = h->magic == FRAME_MAGIC && h->planes == FB_PLANES &&
+                  s + recordSectors(h->len) <= sectorCount;
+    if (!slot->valid) {
+      continue;
+    }
+    slot->seq = h->seq;
+    slot->sectors = recordSectors(h->len);
+    if (newest < 0 || (int32_t)(slot->seq - slots[newest].seq) > 0) {
+      newest = s;
+    }
+  }
+  scanned = true;
+}
+
+static int slotWithSeq(uint32_t seq)
+{
+  for (size_t s = 0; s < sectorCount; s++) {
+    if (slots[s].valid && slots[s].seq == seq) {
+      return s;
+    }
+  }
+  return -1;
+}
+
+static const uint8_t *payload(const uint8_t *flash, int slot)
+{
+  return flash + (size_t)slot * part->erase_size + sizeof(frame_record_t);
+}
+
+static bool decodeRecord(const uint8_t *flash, int slot, framebuffer_t *fb)
+{
+  const frame_record_t *h = &slots[slot].header;
+  const uint8_t *in = payload(flash, slot);
+  if (esp_rom_crc32_le(0, in, h->len) != h->crc) {
+    return false;
+  }
+  size_t pos = 0;
+  for (int p = 0; p < FB_PLANES; p++) {
+    // A delta applies to what's already in fb, in place
+    size_t used = frameDecode(in + pos, h->len - pos, h->delta ? fb->planes[p] : NULL,
+                              fb->planes[p], FB_PLANE_SIZE);
+    if (!used) {
+      return false;
+    }
+    pos += used;
+  }
+  return true;
+}
+
+// Decode the full frame the newest record builds on, then every delta after it
+static bool decodeChain(const uint8_t *flash, framebuffer_t *fb)
+{
+  int chain[CONFIG_FRAME_KEY_EVERY];
+  int count = 0;
+  for (int s = newest; s >= 0 && count < CONFIG_FRAME_KEY_EVERY;) {
+    chain[count++] = s;
+    if (!slots[s].header.delta) {
+      break;
+    }
+    s = slotWithSeq(slots[s].seq - 1);
+    if (s < 0) {
+      return false;
+    }
+  }
+  if (count == 0 || slots[chain[count - 1]].header.delta) {
+    return false;
+  }
+  while (count) {
+    if (!decodeRecord(flash, chain[--count], fb)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Records are read straight off the flash cache, no copy of the compressed data in RAM
+static const uint8_t *mapFrames(esp_partition_mmap_handle_t *handle)
+{
+  const void *flash;
+  if (esp_partition_mmap(part, 0, sectorCount * part->erase_size, ESP_PARTITION_MMAP_DATA, &flash,
+                         handle) != ESP_OK) {
+    ESP_LOGE("FRAME", "can't map the frame partition");
+    return NULL;
+  }
+  return flash;
+}
+
+bool frameStoreLoad(framebuffer_t *fb)
+{
+  esp_partition_mmap_handle_t handle;
+  const uint8_t *flash = framePartition() ? mapFrames(&handle) : NULL;
+  if (!flash) {
+    return false;
+  }
+  scan(flash);
+  bool ok = newest >= 0 && decodeChain(flash, fb);
+  esp_partition_munmap(handle);
+  if (!ok && newest >= 0) {
+    ESP_LOGW("FRAME", "stored frame %lu unusable", (unsigned long)slots[newest].seq);
+  }
+  return ok;
+}
+
+// Where the encoded stream goes next, and its CRC so far
+typedef struct {
+  size_t offset;
+  uint32_t crc;
+  esp_err_t err;
+} frame_writer_t;
+
+static void writeSink(void *ctx, const uint8_t *data, size_t len)
+{
+  frame_writer_t *w = ctx;
+  if (w->err == ESP_OK) {
+    w->err = esp_partition_write(part, w->offset, data, len);
+  }
+  w->offset += len;
+}
+
+static void crcSink(void *ctx, const uint8_t *data, size_t len)
+{
+  frame_writer_t *w = ctx;
+  w->crc = esp_rom_crc32_le(w->crc, data, len);
+}
+
+static size_t encodeFrame(const framebuffer_t *fb, const framebuffer_t *ref, frame_sink_t sink,
+                          frame_writer_t *w)
+{
+  size_t len = 0;
+  for (int p = 0; p < FB_PLANES; p++) {
+    len += frameEncode(fb->planes[p], ref ? ref->planes[p] : NULL, FB_PLANE_SIZE, sink, w);
+  }
+  return len;
+}
+
+// Whether [start, start + count) would erase part of the chain the newest record needs
+static bool overlapsChain(size_t start, size_t count)
+{
+  for (int s = newest, n = 0; s >= 0 && n < CONFIG_FRAME_KEY_EVERY; n++) {
+    for (size_t i = 0; i < slots[s].sectors; i++) {
+      if (s + i >= start && s + i < start + count) {
+        return true;
+      }
+    }
+    if (!slots[s].header.delta) {
+      break;
+    }
+    s = slotWithSeq(slots[s].seq - 1);
+  }
+  return false;
+}
+
+// Whatever is stored no longer matches the panel, clear every header's magic (no erase needed)
+static void invalidateAll(void)
+{
+  const uint32_t zero = 0;
+  for (size_t s = 0; s < sectorCount; s++) {
+    if (slots[s].valid) {
+      esp_partition_write(part, s * part->erase_size, &zero, sizeof(zero));
+      slots[s].valid = false;
+    }
+  }
+  newest = -1;
+}
+
+esp_err_t frameStoreSave(const framebuffer_t *fb, const framebuffer_t *prev)
+{
+  if (!framePartition()) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  if (!scanned) {
+    esp_partition_mmap_handle_t handle;
+    const uint8_t *flash = mapFrames(&handle);
+    if (!flash) {
+      return ESP_FAIL;
+    }
+    scan(flash);
+    esp_partition_munmap(handle);
+  }
+
+  // A delta on what was there if we know it's the newest record, a full frame every so often so
+  // loading never has to go far back
+  const frame_record_t *last = newest >= 0 ? &slots[newest].header : NULL;
+  bool delta = prev && last && last->chain + 1 < CONFIG_FRAME_KEY_EVERY;
+  size_t start = newest >= 0 ? (newest + slots[newest].sectors) % sectorCount : 0;
+
+  frame_writer_t w = {0};
+  size_t len = encodeFrame(fb, delta ? prev : NULL, crcSink, &w);
+  size_t need = recordSectors(len);
+  if (start + need > sectorCount) {
+    start = 0;
+  }
+  if (delta && overlapsChain(start, need)) {
+    delta = false;
+    w.crc = 0;
+    len = encodeFrame(fb, NULL, crcSink, &w);
+    need = recordSectors(len);
+    start = start + need > sectorCount ? 0 : start;
+  }
+
+  esp_err_t err = need > sectorCount ? ESP_ERR_INVALID_SIZE : ESP_OK;
+  if (err == ESP_OK) {
+    err = esp_partition_erase_range(part, start * part->erase_size, need * part->erase_size);
+  }
+  const frame_record_t header = {
+      .magic = FRAME_MAGIC,
+      .seq = last ? last->seq + 1 : 0,
+      .len = len,
+      .crc = w.crc,
+      .delta = delta,
+      .planes = FB_PLANES,
+      .chain = delta ? last->chain + 1 : 0,
+  };
+  if (err == ESP_OK) {
+    err = esp_partition_write(part, start * part->erase_size, &header, sizeof(header));
+  }
+  if (err == ESP_OK) {
+    w = (frame_writer_t){.offset = start * part->erase_size + sizeof(header)};
+    encodeFrame(fb, delta ? prev : NULL, writeSink, &w);
+    err = w.err;
+  }
+  if (err != ESP_OK) {
+    ESP_LOGE("FRAME", "saving frame failed: %s", esp_err_to_name(err));
+    invalidateAll();
+    return err;
+  }
+
+  // Records in the sectors just erased are gone
+  for (size_t s = 0; s < sectorCount; s++) {
+    if (slots[s].valid && s < start + need && s + slots[s].sectors > start) {
+      slots[s].valid = false;
+    }
+  }
+  slots[start] = (frame_slot_t){
+      .valid = true,
+      .seq = header.seq,
+      .sectors = need,
+      .header = header,
+  };
+  newest = start;
+  ESP_LOGI("FRAME", "saved frame %lu, %s, %u bytes", (unsigned long)header.seq,
+           delta ? "delta" : "full", (unsigned)len);
+  return ESP_OK;
+}
@@ -0,0 +1,148 @@
+#include "framebuffer.h"
+
+#include <string.h>
+
+#include "raster.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#define FB_ATTR DMA_ATTR
+#if CONFIG_SPIRAM_ALLOW_BSS_SEG_EXTERNAL_MEMORY
+#define FB_PREV_ATTR EXT_RAM_BSS_ATTR
+#endif
+#else
+#define FB_ATTR __attribute__((aligned(4)))
+#endif
+
+#ifndef FB_PREV_ATTR
+#define FB_PREV_ATTR __attribute__((aligned(4)))
+#endif
+
+// 48 KB per plane, reserved at link time so it can't fragment (or fail to come off) the heap
+FB_ATTR static uint8_t fbMemory[FB_SIZE];
+static framebuffer_t fbMainFrame;
+
+#if CONFIG_EPD_PARTIAL_REFRESH
+// Only ever read by the CPU, so it doesn't need to be DMA capable
+FB_PREV_ATTR static uint8_t fbPrevMemory[FB_SIZE];
+static framebuffer_t fbPrevFrame;
+#endif
+
+void fbInit(framebuffer_t *fb, uint8_t *mem)
+{
+  for (int p = 0; p < FB_PLANES; p++) {
+    fb->planes[p] = mem + (size_t)p * FB_PLANE_SIZE;
+  }
+}
+
+framebuffer_t *fbMain(void)
+{
+  if (!fbMainFrame.planes[0]) {
+    fbInit(&fbMainFrame, fbMemory);
+  }
+  return &fbMainFrame;
+}
+
+#if CONFIG_EPD_PARTIAL_REFRESH
+framebuffer_t *fbPrevious(void)
+{
+  if (!fbPrevFrame.planes[0]) {
+    fbInit(&fbPrevFrame, fbPrevMemory);
+  }
+  return &fbPrevFrame;
+}
+#endif
+
+void fbClear(framebuffer_t *fb, uint8_t color)
+{
+  for (int p = 0; p < FB_PLANES; p++) {
+    memset(fb->planes[p], (color & (1 << p)) ? 0xFF : 0x00, FB_PLANE_SIZE);
+  }
+}
+
+// Clip to the panel and fill every row of the rectangle with color, or invert it
+static void rectOp(framebuffer_t *fb, int x, int y, int w, int h, uint8_t color, bool invert)
+{
+  if (x < 0) {
+    w += x;
+    x = 0;
+  }
+  if (y < 0) {
+    h += y;
+    y = 0;
+  }
+  if (x + w > FB_WIDTH) {
+    w = FB_WIDTH - x;
+  }
+  if (y + h > FB_HEIGHT) {
+    h = FB_HEIGHT - y;
+  }
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+
+  for (int p = 0; p < FB_PLANES; p++) {
+    raster_op_t op = invert ? RASTER_INVERT : (color & (1 << p)) ? RASTER_SET : RASTER_CLEAR;
+    for (int row = y; row < y + h; row++) {
+      rasterSpan(fb->planes[p] + (size_t)row * FB_STRIDE, x, x + w, op);
+    }
+  }
+}
+
+void fbFillRect(framebuffer_t *fb, int x, int y, int w, int h, uint8_t color)
+{
+  rectOp(fb, x, y, w, h, color, false);
+}
+
+void fbInvertRect(framebuffer_t *fb, int x, int y, int w, int h)
+{
+  rectOp(fb, x, y, w, h, FB_BLACK, true);
+}
+
+void fbBlit(framebuffer_t *fb, const bitmap_t *bm, int x, int y, uint8_t color)
+{
+  if (x < 0 || x + bm->width > FB_WIDTH) {
+    // Hanging off the side, not worth a fast path
+    for (int row = 0; row < bm->height; row++) {
+      const uint8_t *src = bm->data + (size_t)row * bm->stride;
+      for (int col = 0; col < bm->width; col++) {
+        if (src[col >> 3] & (0x80 >> (col & 7))) {
+          fbSetPixel(fb, x + col, y + row, color);
+        }
+      }
+    }
+    return;
+  }
+
+  int row0 = y < 0 ? -y : 0;
+  int rows = y + bm->height > FB_HEIGHT ? FB_HEIGHT - y : bm->height;
+  for (int p = 0; p < FB_PLANES; p++) {
+    bool set = color & (1 << p);
+    for (int row = row0; row < rows; row++) {
+      rasterBlit(fb->planes[p] + (size_t)(y + row) * FB_STRIDE, x,
+                 bm->data + (size_t)row * bm->stride, bm->width, set);
+    }
+  }
+}
+
+bool fbDiff(const framebuffer_t *a, const framebuffer_t *b, fb_rect_t *changed)
+{
+  bool any = false;
+  for (int p = 0; p < FB_PLANES; p++) {
+    fb_rect_t r;
+    if (!rasterDiff(a->planes[p], b->planes[p], &r)) {
+      continue;
+    }
+    if (any) {
+      int x1 = changed->x + changed->w > r.x + r.w ? changed->x + changed->w : r.x + r.w;
+      int y1 = changed->y + changed->h > r.y + r.h ? changed->y + changed->h : r.y + r.h;
+      r.x = changed->x < r.x ? changed->x : r.x;
+      r.y = changed->y < r.y ? changed->y : r.y;
+      r.w = x1 - r.x;
+      r.h = y1 - r.y;
+    }
+    *changed = r;
+    any = true;
+  }
+  return any;
+}
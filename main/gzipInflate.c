@@ -0,0 +1,207 @@
+#include "gzipInflate.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_rom_crc.h"
+#define CRC32(crc, data, len) esp_rom_crc32_le(crc, data, len)
+#else
+// Host build, against the miniz sources instead of the ROM
+#define CRC32(crc, data, len) (uint32_t)mz_crc32(crc, data, len)
+#endif
+
+// RFC 1952 header flags
+#define FHCRC 0x02
+#define FEXTRA 0x04
+#define FNAME 0x08
+#define FCOMMENT 0x10
+
+enum {
+  GZ_FIXED,      // ID1 ID2 CM FLG MTIME(4) XFL OS
+  GZ_EXTRA_LEN,
+  GZ_EXTRA,
+  GZ_NAME,
+  GZ_COMMENT,
+  GZ_HCRC,
+  GZ_DEFLATE,
+  GZ_TRAILER,    // CRC32 and ISIZE of the output, little endian
+};
+
+void gzipInit(gzip_inflater_t *gz, uint8_t *dict, gzip_output_t out, void *ctx)
+{
+  tinfl_init(&gz->inflator);
+  gz->dict = dict;
+  gz->dictOfs = 0;
+  gz->out = out;
+  gz->ctx = ctx;
+  gz->state = GZ_FIXED;
+  gz->flags = 0;
+  gz->skip = 10;
+  gz->extraLo = 0;
+  gz->crc = 0;
+  gz->size = 0;
+  gz->trailerLen = 0;
+  gz->done = false;
+  gz->failed = false;
+}
+
+// Move on to the next optional header field that's present
+static void nextHeaderField(gzip_inflater_t *gz)
+{
+  while (gz->state < GZ_DEFLATE) {
+    gz->state++;
+    switch (gz->state) {
+      case GZ_EXTRA_LEN:
+        if (gz->flags & FEXTRA) {
+          gz->skip = 2;
+          return;
+        }
+        break;
+      case GZ_NAME:
+        if (gz->flags & FNAME) {
+          return;
+        }
+        break;
+      case GZ_COMMENT:
+        if (gz->flags & FCOMMENT) {
+          return;
+        }
+        break;
+      case GZ_HCRC:
+        if (gz->flags & FHCRC) {
+          gz->skip = 2;
+          return;
+        }
+        break;
+      case GZ_DEFLATE:
+        return;
+      default:
+        // GZ_EXTRA is entered from GZ_EXTRA_LEN directly
+        break;
+    }
+  }
+}
+
+// Eat header bytes, returns how many were consumed
+static size_t feedHeader(gzip_inflater_t *gz, const uint8_t *data, size_t len)
+{
+  size_t used = 0;
+
+  while (used < len && gz->state < GZ_DEFLATE) {
+    uint8_t c = data[used++];
+    switch (gz->state) {
+      case GZ_FIXED:
+        // Check magic and method as they go past, remember the flags
+        switch (10 - gz->skip) {
+          case 0:
+            gz->failed |= c != 0x1F;
+            break;
+          case 1:
+            gz->failed |= c != 0x8B;
+            break;
+          case 2:
+            gz->failed |= c != 8;
+            break;
+          case 3:
+            gz->flags = c;
+            break;
+        }
+        if (--gz->skip == 0) {
+          nextHeaderField(gz);
+        }
+        break;
+
+      case GZ_EXTRA_LEN:
+        // Little endian length, low byte first
+        if (gz->skip == 2) {
+          gz->extraLo = c;
+          gz->skip = 1;
+          break;
+        }
+        gz->skip = (uint16_t)(gz->extraLo | c << 8);
+        gz->state = GZ_EXTRA;
+        if (gz->skip == 0) {
+          nextHeaderField(gz);
+        }
+        break;
+
+      case GZ_EXTRA:
+      case GZ_HCRC:
+        if (--gz->skip == 0) {
+          nextHeaderField(gz);
+        }
+        break;
+
+      case GZ_NAME:
+      case GZ_COMMENT:
+        if (c == '\0') {
+          nextHeaderField(gz);
+        }
+        break;
+    }
+  }
+  return used;
+}
+
+bool gzipFeed(gzip_inflater_t *gz, const uint8_t *data, size_t len)
+{
+  size_t used = 0;
+
+  while (!gz->failed && !gz->done) {
+    if (gz->state < GZ_DEFLATE) {
+      used += feedHeader(gz, data + used, len - used);
+      if (gz->state < GZ_DEFLATE) {
+        break;
+      }
+    }
+    if (gz->state == GZ_TRAILER) {
+      while (used < len && gz->trailerLen < sizeof(gz->trailer)) {
+        gz->trailer[gz->trailerLen++] = data[used++];
+      }
+      gz->done = gz->trailerLen == sizeof(gz->trailer);
+      break;
+    }
+
+    size_t inBytes = len - used;
+    size_t outBytes = GZIP_DICT_SIZE - gz->dictOfs;
+    tinfl_status status = tinfl_decompress(&gz->inflator, data + used, &inBytes, gz->dict,
+                                           gz->dict + gz->dictOfs, &outBytes,
+                                           TINFL_FLAG_HAS_MORE_INPUT);
+    used += inBytes;
+
+    if (outBytes) {
+      gz->crc = CRC32(gz->crc, gz->dict + gz->dictOfs, outBytes);
+      gz->size += outBytes;
+      if (gz->out) {
+        gz->out(gz->ctx, gz->dict + gz->dictOfs, outBytes);
+      }
+    }
+    gz->dictOfs = (gz->dictOfs + outBytes) & (GZIP_DICT_SIZE - 1);
+
+    if (status == TINFL_STATUS_DONE) {
+      // tinfl reads ahead and doesn't give the bytes back, so the whole bytes left in its bit
+      // buffer (past the padding of the last one) are the start of the trailer
+      tinfl_bit_buf_t bits = gz->inflator.m_bit_buf >> (gz->inflator.m_num_bits & 7);
+      for (mz_uint32 n = gz->inflator.m_num_bits / 8; n && gz->trailerLen < sizeof(gz->trailer);
+           n--) {
+        gz->trailer[gz->trailerLen++] = (uint8_t)bits;
+        bits >>= 8;
+      }
+      gz->state = GZ_TRAILER;
+    } else if (status < TINFL_STATUS_DONE) {
+      gz->failed = true;
+    } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT && used == len) {
+      break;
+    }
+  }
+  return !gz->failed;
+}
+
+static uint32_t readLe32(const uint8_t *p)
+{
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+bool gzipFinish(gzip_inflater_t *gz)
+{
+  return gz->done && !gz->failed && readLe32(gz->trailer) == gz->crc &&
+         readLe32(gz->trailer + 4) == gz->size;
+}
@@ -0,0 +1,11 @@
+#include "hash.h"
+
+uint32_t fnv1a(uint32_t hash, const void *data, size_t len)
+{
+  const uint8_t *p = data;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= p[i];
+    hash *= 0x01000193u;
+  }
+  return hash;
+}
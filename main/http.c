@@ -0,0 +1,513 @@
+#include "http.h"
+
+#include <string.h>
+#include <strings.h>
+
+#include "arena.h"
+#include "dnsCache.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "gzipInflate.h"
+#include "httpRequest.h"
+#include "lwip/sockets.h"
+#include "netIo.h"
+#include "nvs.h"
+#include "probe.h"
+#include "sdkconfig.h"
+#include "tls.h"
+
+#define WEATHER_API_KEY CONFIG_ESP_WEATHER_KEY
+#define WEATHER_API_URL CONFIG_WEATHER_API_HOST
+#define WEATHER_API_PORT CONFIG_WEATHER_API_PORT
+
+#ifndef CONFIG_WEATHER_AIR_PATH
+// Air quality is off, nothing asks for it
+#define CONFIG_WEATHER_AIR_PATH ""
+#endif
+
+#define HTTP_NVS_NAMESPACE "http"
+#define HTTP_NVS_VALIDATORS_KEY "validators"
+
+// Cache validators from the last response we actually used
+typedef struct {
+  uint8_t loaded;  // Pulled from NVS already (RTC copy is zeroed on a cold boot)
+  char etag[CONFIG_HTTP_ETAG_MAX];
+  char lastModified[40];
+} http_validators_t;
+
+RTC_DATA_ATTR static http_validators_t validators;
+// What the response in flight sent, only kept once the caller says the body was good
+static http_validators_t pending;
+
+// Working buffers, from the cycle arena for the length of a fetch
+static char *requestBuf;
+
+// A keep-alive connection to one host, plain TCP or TLS on top of it. Kept open across fetches
+// until httpPoolClose(), and addresses stay put (mbedTLS holds on to &tls.net).
+typedef struct {
+  const char *host;  // NULL when the slot is free
+  int fd;
+  int64_t deadlineUs;
+  uint16_t served;   // Responses read on it so far
+  bool closing;      // Server said Connection: close
+#if CONFIG_WEATHER_API_HTTPS
+  tls_conn_t tls;
+#endif
+} http_conn_t;
+
+static http_conn_t pool[CONFIG_HTTP_POOL_SIZE];
+
+// Socket reads land here and are parsed in place
+static uint8_t *recvBuf;
+
+#if CONFIG_WEATHER_API_GZIP
+// Inflater state, only allocated when the server actually compressed a body, then reused for
+// the rest of the fetch
+static gzip_inflater_t *inflater;
+static uint8_t *inflateDict;
+#endif
+
+// The response being read and the request it answers
+static http_fetch_t *current;
+static http_conn_t *currentConn;
+static bool bodyGzip;
+// Some of current's body has gone to its consumer, so it can't be asked for again
+static bool bodyDelivered;
+
+static void loadValidators(void)
+{
+  if (validators.loaded) {
+    return;
+  }
+  validators.loaded = true;
+
+  nvs_handle_t nvs;
+  if (nvs_open(HTTP_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+    return;
+  }
+  size_t len = sizeof(validators);
+  if (nvs_get_blob(nvs, HTTP_NVS_VALIDATORS_KEY, &validators, &len) != ESP_OK ||
+      len != sizeof(validators)) {
+    memset(&validators, 0, sizeof(validators));
+    validators.loaded = true;
+  }
+  nvs_close(nvs);
+}
+
+void httpSaveValidators(void)
+{
+  pending.loaded = true;
+  if (memcmp(&pending, &validators, sizeof(pending)) == 0) {
+    return;
+  }
+  validators = pending;
+
+  nvs_handle_t nvs;
+  if (nvs_open(HTTP_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+    return;
+  }
+  if (nvs_set_blob(nvs, HTTP_NVS_VALIDATORS_KEY, &validators, sizeof(validators)) == ESP_OK) {
+    nvs_commit(nvs);
+  }
+  nvs_close(nvs);
+}
+
+// The one request that's conditional, and whose validators we keep
+static bool validated(const http_fetch_t *fetch)
+{
+  return fetch->endpoint == HTTP_ENDPOINT_FORECAST && !fetch->lat;
+}
+
+// Ask for just what we draw, in the units we draw it in
+static size_t buildRequest(const http_fetch_t *fetch)
+{
+  http_request_t req;
+  bool forecast = fetch->endpoint == HTTP_ENDPOINT_FORECAST;
+  httpRequestBegin(&req, requestBuf, CONFIG_HTTP_REQUEST_BUF_SIZE, "GET", WEATHER_API_URL,
+                   forecast ? CONFIG_WEATHER_API_PATH : CONFIG_WEATHER_AIR_PATH);
+  httpRequestQuery(&req, "lat", fetch->lat ? fetch->lat : CONFIG_WEATHER_LAT);
+  httpRequestQuery(&req, "lon", fetch->lon ? fetch->lon : CONFIG_WEATHER_LON);
+  if (forecast) {
+    httpRequestQuery(&req, "exclude", CONFIG_WEATHER_EXCLUDE);
+    httpRequestQuery(&req, "units", CONFIG_WEATHER_UNITS);
+    httpRequestQuery(&req, "lang", CONFIG_WEATHER_LANG);
+  }
+  httpRequestQuery(&req, "appid", WEATHER_API_KEY);
+  httpRequestHeader(&req, "User-Agent", "esp-idf/1.0 esp32");
+#if CONFIG_WEATHER_API_GZIP
+  httpRequestHeader(&req, "Accept-Encoding", "gzip");
+#endif
+  // Let the server answer 304 if nothing changed since the last response we used. Only the
+  // forecast is conditional, the air quality response is a few hundred bytes anyway.
+  if (validated(fetch) && validators.etag[0]) {
+    httpRequestHeader(&req, "If-None-Match", validators.etag);
+  }
+  if (validated(fetch) && validators.lastModified[0]) {
+    httpRequestHeader(&req, "If-Modified-Since", validators.lastModified);
+  }
+  // HTTP/1.1 connections persist by default, the pool closes them before the radio goes off
+  return httpRequestEnd(&req);
+}
+
+static void onStatus(void *ctx, int status)
+{
+  if (current->cb.onStatus) {
+    current->cb.onStatus(current->cb.ctx, status);
+  }
+}
+
+static void copyHeader(char *dst, size_t size, const char *value)
+{
+  // A truncated validator would never match, better not to send one at all
+  if (strlen(value) < size) {
+    strcpy(dst, value);
+  }
+}
+
+// Whether a comma separated header value lists token. Tokens are case insensitive.
+static bool hasToken(const char *value, const char *token)
+{
+  size_t len = strlen(token);
+  while (*value) {
+    value += strspn(value, " \t,");
+    size_t n = strcspn(value, ",");
+    size_t end = n;
+    while (end && (value[end - 1] == ' ' || value[end - 1] == '\t')) {
+      end--;
+    }
+    if (end == len && strncasecmp(value, token, len) == 0) {
+      return true;
+    }
+    value += n;
+  }
+  return false;
+}
+
+static void onHeader(void *ctx, const char *name, const char *value)
+{
+  if (validated(current) && strcmp(name, "etag") == 0) {
+    copyHeader(pending.etag, sizeof(pending.etag), value);
+  } else if (validated(current) && strcmp(name, "last-modified") == 0) {
+    copyHeader(pending.lastModified, sizeof(pending.lastModified), value);
+  } else if (strcmp(name, "connection") == 0 && hasToken(value, "close")) {
+    // This is the last response on the connection, anything pipelined behind it is dropped
+    currentConn->closing = true;
+  }
+
+#if CONFIG_WEATHER_API_GZIP
+  if (strcmp(name, "content-encoding") == 0 && hasToken(value, "gzip") && !bodyGzip) {
+    if (!inflater) {
+      inflater = arenaAlloc(sizeof(*inflater));
+      inflateDict = arenaAlloc(GZIP_DICT_SIZE);
+    }
+    if (inflater && inflateDict) {
+      bodyGzip = true;
+      gzipInit(inflater, inflateDict, current->cb.onBody, current->cb.ctx);
+    } else {
+      // The body goes to the consumer still compressed and fails to parse, which is a failed fetch
+      ESP_LOGE("HTTP", "No memory for the inflater");
+    }
+  }
+#endif
+  if (current->cb.onHeader) {
+    current->cb.onHeader(current->cb.ctx, name, value);
+  }
+}
+
+static void onBody(void *ctx, const uint8_t *data, size_t len)
+{
+  bodyDelivered |= len > 0;
+#if CONFIG_WEATHER_API_GZIP
+  if (bodyGzip) {
+    gzipFeed(inflater, data, len);
+    return;
+  }
+#endif
+  if (current->cb.onBody) {
+    current->cb.onBody(current->cb.ctx, data, len);
+  }
+}
+
+// Open a TCP connection to the API. If a cached address turns out to be dead, look the host
+// up again and have one more go.
+static int openSocket(const char *host, int64_t deadlineUs)
+{
+  bool cached = true;
+  while (cached) {
+    struct sockaddr_in dest = {
+        .sin_family = AF_INET,
+        .sin_port = htons(WEATHER_API_PORT),
+    };
+    probeBegin(PROBE_DNS);
+    esp_err_t err = dnsResolve(host, &dest.sin_addr, &cached, deadlineUs);
+    probeEnd(PROBE_DNS);
+    if (err != ESP_OK) {
+      ESP_LOGE("HTTP", "DNS lookup failed");
+      return -1;
+    }
+    ESP_LOGI("HTTP", "DNS lookup succeeded. IP=%s%s", inet_ntoa(dest.sin_addr),
+             cached ? " (cached)" : "");
+
+    probeBegin(PROBE_TCP);
+    int s = netConnect(&dest, deadlineUs);
+    probeEnd(PROBE_TCP);
+    if (s >= 0) {
+      return s;
+    }
+    ESP_LOGE("HTTP", "Socket failed to connect (errno %d)", errno);
+    dnsInvalidate(host);
+    if (cached) {
+      probeAddRetry();
+    }
+  }
+  return -1;
+}
+
+static int connRead(http_conn_t *conn, uint8_t *buf, size_t len)
+{
+#if CONFIG_WEATHER_API_HTTPS
+  return tlsRead(&conn->tls, buf, len);
+#else
+  return netRead(conn->fd, buf, len, conn->deadlineUs);
+#endif
+}
+
+static int connWrite(http_conn_t *conn, const void *buf, size_t len)
+{
+#if CONFIG_WEATHER_API_HTTPS
+  return tlsWrite(&conn->tls, buf, len);
+#else
+  return netWrite(conn->fd, buf, len, conn->deadlineUs);
+#endif
+}
+
+static void connClose(http_conn_t *conn)
+{
+  if (!conn->host) {
+    return;
+  }
+#if CONFIG_WEATHER_API_HTTPS
+  tlsClose(&conn->tls);
+#else
+  close(conn->fd);
+#endif
+  ESP_LOGI("HTTP", "Closed connection to %s after %u responses", conn->host, conn->served);
+  conn->host = NULL;
+}
+
+// The pooled connection to host, opening one (in a free slot, or in place of the oldest) if
+// there isn't one yet
+static http_conn_t *connAcquire(const char *host, int64_t deadlineUs, bool *reused)
+{
+  http_conn_t *conn = NULL;
+  for (int i = 0; i < CONFIG_HTTP_POOL_SIZE; i++) {
+    if (pool[i].host && strcmp(pool[i].host, host) == 0) {
+      pool[i].deadlineUs = deadlineUs;
+#if CONFIG_WEATHER_API_HTTPS
+      pool[i].tls.deadlineUs = deadlineUs;
+#endif
+      *reused = true;
+      return &pool[i];
+    }
+    if (!conn && !pool[i].host) {
+      conn = &pool[i];
+    }
+  }
+  if (!conn) {
+    conn = &pool[0];
+    connClose(conn);
+  }
+  *reused = false;
+
+  int s = openSocket(host, deadlineUs);
+  if (s < 0) {
+    return NULL;
+  }
+  ESP_LOGI("HTTP", "Socket connected");
+
+#if CONFIG_WEATHER_API_HTTPS
+  probeBegin(PROBE_TLS);
+  esp_err_t err = tlsConnect(&conn->tls, s, host, deadlineUs);
+  probeEnd(PROBE_TLS);
+  if (err != ESP_OK) {
+    close(s);
+    return NULL;
+  }
+#endif
+  conn->host = host;
+  conn->fd = s;
+  conn->deadlineUs = deadlineUs;
+  conn->served = 0;
+  conn->closing = false;
+  return conn;
+}
+
+static void beginResponse(http_fetch_t *fetch, http_parser_t *parser)
+{
+  current = fetch;
+  bodyGzip = false;
+  bodyDelivered = false;
+  if (validated(fetch)) {
+    memset(&pending, 0, sizeof(pending));
+  }
+  httpParserReset(parser);
+}
+
+static esp_err_t endResponse(http_parser_t *parser)
+{
+  // Done with one way or the other, nothing of it is left hanging
+  bodyDelivered = false;
+  if (!httpParserDone(parser)) {
+    ESP_LOGE("HTTP", "Incomplete response");
+    return ESP_FAIL;
+  }
+#if CONFIG_WEATHER_API_GZIP
+  if (bodyGzip && !gzipFinish(inflater)) {
+    ESP_LOGE("HTTP", "Corrupt gzip body");
+    return ESP_FAIL;
+  }
+#endif
+  return ESP_OK;
+}
+
+// Write every outstanding request back to back, then read the responses in the same order.
+// Returns how many fetches it got through, the connection is closed unless that's all of them.
+static size_t pipeline(http_conn_t *conn, http_fetch_t *fetches, size_t count)
+{
+  bodyDelivered = false;
+  for (size_t i = 0; i < count; i++) {
+    size_t reqLen = buildRequest(&fetches[i]);
+    if (reqLen == 0) {
+      ESP_LOGE("HTTP", "Request doesn't fit in %d bytes", CONFIG_HTTP_REQUEST_BUF_SIZE);
+      connClose(conn);
+      return 0;
+    }
+    if (connWrite(conn, requestBuf, reqLen) < 0) {
+      ESP_LOGE("HTTP", "Socket sending failure");
+      connClose(conn);
+      return 0;
+    }
+  }
+  ESP_LOGI("HTTP", "%u requests sent", (unsigned)count);
+  probeBegin(PROBE_FIRST_BYTE);
+
+  // Parse the responses as they arrive, body slices go straight to each fetch's consumer
+  const http_callbacks_t wrapped = {
+      .onStatus = onStatus,
+      .onHeader = onHeader,
+      .onBody = onBody,
+  };
+  http_parser_t parser;
+  httpParserInit(&parser, &wrapped);
+  currentConn = conn;
+  size_t done = 0;
+  beginResponse(&fetches[0], &parser);
+
+  int r;
+  bool last = false;  // The server is closing after the response that just ended
+  do {
+    r = connRead(conn, recvBuf, CONFIG_HTTP_RECV_BUF_SIZE);
+    if (r > 0) {
+      probeEnd(PROBE_FIRST_BYTE);
+      probeBegin(PROBE_BODY);
+      probeAddRx(r);
+    } else if (r == 0) {
+      httpParserFinish(&parser);
+    }
+    // One read can end one response and start the next
+    for (int used = 0; used < r && !last && !httpParserFailed(&parser);) {
+      used += httpParserFeed(&parser, recvBuf + used, r - used);
+      if (httpParserDone(&parser)) {
+        conn->served++;
+        fetches[done].result = endResponse(&parser);
+        last = ++done == count || conn->closing;
+        if (!last) {
+          beginResponse(&fetches[done], &parser);
+        }
+      }
+    }
+    if (r == 0 && httpParserDone(&parser) && !last) {
+      // A read-until-close body, the close is what ended it
+      conn->served++;
+      fetches[done].result = endResponse(&parser);
+      done++;
+    }
+  } while (r > 0 && !last && !httpParserFailed(&parser));
+
+  probeEnd(PROBE_FIRST_BYTE);
+  probeEnd(PROBE_BODY);
+  ESP_LOGI("HTTP", "... done reading. %u of %u responses, last read=%d errno=%d.",
+           (unsigned)done, (unsigned)count, r, errno);
+
+  // Anything but a clean finish leaves the connection in an unknown state
+  if (done < count || conn->closing || httpParserFailed(&parser)) {
+    connClose(conn);
+  }
+  return done;
+}
+
+esp_err_t httpFetch(http_fetch_t *fetches, size_t count)
+{
+  for (size_t i = 0; i < count; i++) {
+    fetches[i].result = ESP_FAIL;
+  }
+  loadValidators();
+
+  requestBuf = arenaAlloc(CONFIG_HTTP_REQUEST_BUF_SIZE);
+  recvBuf = arenaAlloc(CONFIG_HTTP_RECV_BUF_SIZE);
+#if CONFIG_WEATHER_API_GZIP
+  inflater = NULL;
+  inflateDict = NULL;
+#endif
+  if (!requestBuf || !recvBuf) {
+    ESP_LOGE("HTTP", "No memory for request buffers");
+  }
+
+  // One budget for the whole fetch, connect to the last body byte of the last response
+  int64_t deadlineUs = netDeadline(CONFIG_HTTP_FETCH_TIMEOUT_MS);
+  size_t done = 0;
+  while (requestBuf && recvBuf && done < count) {
+    bool reused;
+    http_conn_t *conn = connAcquire(WEATHER_API_URL, deadlineUs, &reused);
+    if (!conn) {
+      break;
+    }
+    // Whatever didn't get an answer goes again on a new connection: a pooled one the server has
+    // since dropped, or a server that closes part way through the pipeline. A new connection
+    // that gets nowhere won't do better the second time.
+    size_t got = pipeline(conn, fetches + done, count - done);
+    done += got;
+    if (done < count && bodyDelivered) {
+      // Cut off part way through the body. Its consumer is mid document and can't take it from
+      // the top again, so that one stays failed and only the rest go again.
+      ESP_LOGW("HTTP", "Response %u cut off in its body, not retried", (unsigned)done);
+      done++;
+      got++;
+    }
+    if (!reused && got == 0) {
+      break;
+    }
+  }
+
+  // Newest first, so each block goes straight back to the arena
+#if CONFIG_WEATHER_API_GZIP
+  arenaFree(inflateDict);
+  arenaFree(inflater);
+#endif
+  arenaFree(recvBuf);
+  arenaFree(requestBuf);
+
+  for (size_t i = 0; i < count; i++) {
+    if (fetches[i].result != ESP_OK) {
+      return ESP_FAIL;
+    }
+  }
+  return ESP_OK;
+}
+
+void httpPoolClose(void)
+{
+  for (int i = 0; i < CONFIG_HTTP_POOL_SIZE; i++) {
+    connClose(&pool[i]);
+  }
+}
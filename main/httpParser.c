@@ -0,0 +1,238 @@
+#include "httpParser.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+void httpParserInit(http_parser_t *parser, const http_callbacks_t *cb)
+{
+  memset(parser, 0, sizeof(*parser));
+  if (cb) {
+    parser->cb = *cb;
+  }
+}
+
+void httpParserReset(http_parser_t *parser)
+{
+  http_callbacks_t cb = parser->cb;
+  httpParserInit(parser, &cb);
+}
+
+// Header names are case insensitive, normalise them once here
+static void toLower(char *s)
+{
+  for (; *s; s++) {
+    *s = (char)tolower((unsigned char)*s);
+  }
+}
+
+static bool parseStatusLine(http_parser_t *parser, char *line)
+{
+  // HTTP/1.1 200 OK
+  if (strncmp(line, "HTTP/", 5) != 0) {
+    return false;
+  }
+  char *sp = strchr(line, ' ');
+  if (!sp) {
+    return false;
+  }
+  parser->status = (int)strtol(sp + 1, NULL, 10);
+  if (parser->status < 100 || parser->status > 999) {
+    return false;
+  }
+
+  if (parser->cb.onStatus) {
+    parser->cb.onStatus(parser->cb.ctx, parser->status);
+  }
+  return true;
+}
+
+static bool parseHeaderLine(http_parser_t *parser, char *line)
+{
+  char *colon = strchr(line, ':');
+  if (!colon) {
+    return false;
+  }
+  *colon = '\0';
+  char *value = colon + 1;
+  while (*value == ' ' || *value == '\t') {
+    value++;
+  }
+  char *end = value + strlen(value);
+  while (end > value && (end[-1] == ' ' || end[-1] == '\t')) {
+    *--end = '\0';
+  }
+  toLower(line);
+
+  if (strcmp(line, "content-length") == 0) {
+    parser->hasLength = true;
+    parser->remaining = strtoull(value, NULL, 10);
+  } else if (strcmp(line, "transfer-encoding") == 0) {
+    // chunked is always the last coding applied
+    size_t len = strlen(value);
+    parser->chunked = len >= 7 && strncasecmp(value + len - 7, "chunked", 7) == 0;
+  }
+
+  if (parser->cb.onHeader) {
+    parser->cb.onHeader(parser->cb.ctx, line, value);
+  }
+  return true;
+}
+
+// Blank line after the headers, work out how the body is framed
+static void headersComplete(http_parser_t *parser)
+{
+  int status = parser->status;
+
+  // Interim response (100 Continue), the real one follows
+  if (status < 200) {
+    httpParserReset(parser);
+    return;
+  }
+
+  if (status == 204 || status == 304) {
+    parser->state = HTTP_PARSE_DONE;
+  } else if (parser->chunked) {
+    parser->state = HTTP_PARSE_CHUNK_SIZE;
+  } else if (parser->hasLength && parser->remaining == 0) {
+    parser->state = HTTP_PARSE_DONE;
+  } else {
+    parser->state = HTTP_PARSE_BODY;
+  }
+}
+
+static void lineComplete(http_parser_t *parser)
+{
+  char *line = parser->line;
+  bool ok = true;
+
+  switch (parser->state) {
+    case HTTP_PARSE_STATUS:
+      ok = parseStatusLine(parser, line);
+      if (ok) {
+        parser->state = HTTP_PARSE_HEADERS;
+      }
+      break;
+
+    case HTTP_PARSE_HEADERS:
+      if (parser->lineLen == 0) {
+        headersComplete(parser);
+      } else if (!parser->lineOverflow) {
+        ok = parseHeaderLine(parser, line);
+      }
+      // An oversized header is dropped rather than failing the whole response
+      break;
+
+    case HTTP_PARSE_CHUNK_SIZE:
+      char *end;
+      parser->remaining = strtoull(line, &end, 16);
+      // Anything after the size is a chunk extension, which we don't care about
+      ok = end != line && (*end == '\0' || *end == ';' || *end == ' ');
+      if (ok) {
+        parser->state = parser->remaining ? HTTP_PARSE_CHUNK_DATA : HTTP_PARSE_TRAILERS;
+      }
+      break;
+
+    case HTTP_PARSE_CHUNK_END:
+      ok = parser->lineLen == 0;
+      parser->state = HTTP_PARSE_CHUNK_SIZE;
+      break;
+
+    case HTTP_PARSE_TRAILERS:
+      if (parser->lineLen == 0) {
+        parser->state = HTTP_PARSE_DONE;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  if (!ok) {
+    parser->state = HTTP_PARSE_ERROR;
+  }
+  parser->lineLen = 0;
+  parser->lineOverflow = false;
+}
+
+// Collect bytes of a CRLF terminated line, returns bytes consumed
+static size_t feedLine(http_parser_t *parser, const uint8_t *data, size_t len)
+{
+  const uint8_t *nl = memchr(data, '\n', len);
+  size_t take = nl ? (size_t)(nl - data) + 1 : len;
+  size_t keep = nl ? take - 1 : take;
+
+  size_t room = sizeof(parser->line) - 1 - parser->lineLen;
+  if (keep > room) {
+    keep = room;
+    parser->lineOverflow = true;
+  }
+  memcpy(parser->line + parser->lineLen, data, keep);
+  parser->lineLen += keep;
+
+  if (nl) {
+    if (parser->lineLen && parser->line[parser->lineLen - 1] == '\r') {
+      parser->lineLen--;
+    }
+    parser->line[parser->lineLen] = '\0';
+    lineComplete(parser);
+  }
+  return take;
+}
+
+// Hand a piece of body straight to the consumer, no copying
+static size_t feedBody(http_parser_t *parser, const uint8_t *data, size_t len)
+{
+  size_t take = len;
+  bool bounded = parser->state == HTTP_PARSE_CHUNK_DATA || parser->hasLength;
+  if (bounded && take > parser->remaining) {
+    take = (size_t)parser->remaining;
+  }
+
+  if (take && parser->cb.onBody) {
+    parser->cb.onBody(parser->cb.ctx, data, take);
+  }
+
+  if (bounded) {
+    parser->remaining -= take;
+    if (parser->remaining == 0) {
+      parser->state =
+          parser->state == HTTP_PARSE_CHUNK_DATA ? HTTP_PARSE_CHUNK_END : HTTP_PARSE_DONE;
+    }
+  }
+  return take;
+}
+
+size_t httpParserFeed(http_parser_t *parser, const uint8_t *data, size_t len)
+{
+  size_t used = 0;
+
+  while (used < len) {
+    switch (parser->state) {
+      case HTTP_PARSE_BODY:
+      case HTTP_PARSE_CHUNK_DATA:
+        used += feedBody(parser, data + used, len - used);
+        break;
+
+      case HTTP_PARSE_DONE:
+      case HTTP_PARSE_ERROR:
+        return used;
+
+      default:
+        used += feedLine(parser, data + used, len - used);
+        break;
+    }
+  }
+  return used;
+}
+
+void httpParserFinish(http_parser_t *parser)
+{
+  if (parser->state == HTTP_PARSE_BODY && !parser->hasLength) {
+    parser->state = HTTP_PARSE_DONE;
+  } else if (parser->state != HTTP_PARSE_DONE) {
+    // Connection dropped mid-response
+    parser->state = HTTP_PARSE_ERROR;
+  }
+}
@@ -0,0 +1,92 @@
+#include "httpRequest.h"
+
+#include <string.h>
+
+static void append(http_request_t *req, const char *s, size_t n)
+{
+  if (req->overflow || req->len + n >= req->size) {
+    req->overflow = true;
+    return;
+  }
+  memcpy(req->buf + req->len, s, n);
+  req->len += n;
+  req->buf[req->len] = '\0';
+}
+
+static void appendStr(http_request_t *req, const char *s)
+{
+  append(req, s, strlen(s));
+}
+
+static void appendEscaped(http_request_t *req, const char *s)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    // RFC 3986 unreserved, plus ',' which the API uses as a list separator
+    if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' ||
+        c == '_' || c == '.' || c == '~' || c == ',') {
+      append(req, (const char *)&c, 1);
+    } else {
+      char esc[3] = {'%', hex[c >> 4], hex[c & 0xF]};
+      append(req, esc, sizeof(esc));
+    }
+  }
+}
+
+// Finish the request line the first time a header is added
+static void endTarget(http_request_t *req)
+{
+  if (!req->inQuery) {
+    return;
+  }
+  req->inQuery = false;
+  appendStr(req, " HTTP/1.1\r\nHost: ");
+  appendStr(req, req->host);
+  appendStr(req, "\r\n");
+}
+
+void httpRequestBegin(http_request_t *req, char *buf, size_t size, const char *method,
+                      const char *host, const char *path)
+{
+  *req = (http_request_t){
+      .buf = buf,
+      .size = size,
+      .host = host,
+      .inQuery = true,
+  };
+  if (size) {
+    buf[0] = '\0';
+  }
+  appendStr(req, method);
+  appendStr(req, " ");
+  appendStr(req, path);
+}
+
+void httpRequestQuery(http_request_t *req, const char *name, const char *value)
+{
+  if (!req->inQuery || !value || !*value) {
+    return;
+  }
+  appendStr(req, req->hasQuery ? "&" : "?");
+  req->hasQuery = true;
+  appendStr(req, name);
+  appendStr(req, "=");
+  appendEscaped(req, value);
+}
+
+void httpRequestHeader(http_request_t *req, const char *name, const char *value)
+{
+  endTarget(req);
+  appendStr(req, name);
+  appendStr(req, ": ");
+  appendStr(req, value);
+  appendStr(req, "\r\n");
+}
+
+size_t httpRequestEnd(http_request_t *req)
+{
+  endTarget(req);
+  appendStr(req, "\r\n");
+  return req->overflow ? 0 : req->len;
+}
@@ -0,0 +1,234 @@
+#include "hub.h"
+
+#if CONFIG_DEVICE_ROLE_HUB
+
+#include <string.h>
+
+#include "arena.h"
+#include "esp_log.h"
+#include "esp_now.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "http.h"
+#include "snapshotCodec.h"
+#include "tls.h"
+#include "weatherJson.h"
+#include "wifi.h"
+
+#define HUB_LOCATIONS CONFIG_HUB_MAX_LOCATIONS
+#define REFRESH_INTERVAL_US ((int64_t)CONFIG_REFRESH_INTERVAL_SEC * 1000000)
+#define REFRESH_RETRY_US ((int64_t)CONFIG_REFRESH_RETRY_SEC * 1000000)
+// Gap between frames in a burst, so they don't pile up in the ESP-NOW queue
+#define HUB_FRAME_GAP_MS 5
+
+// Requests per location, the forecast and maybe its air quality
+#if CONFIG_WEATHER_AIR_QUALITY
+#define FETCHES_PER_LOCATION 2
+#else
+#define FETCHES_PER_LOCATION 1
+#endif
+
+_Static_assert(SNAPSHOT_FRAME_MAX <= ESP_NOW_MAX_DATA_LEN, "frames have to fit in one ESP-NOW send");
+
+static const uint8_t broadcastAddr[ESP_NOW_ETH_ALEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+typedef struct {
+  char lat[16];
+  char lon[16];
+} hub_location_t;
+
+static hub_location_t locations[HUB_LOCATIONS];
+static size_t locationCount;
+
+// Last good snapshot per location, encoded and ready to broadcast (0 length until there is one)
+static uint8_t frames[HUB_LOCATIONS][SNAPSHOT_FRAME_MAX];
+static size_t frameLen[HUB_LOCATIONS];
+
+// Per response parse state, one forecast and maybe one air quality per location
+typedef struct {
+  int status;
+  weather_parser_t parser;
+} hub_fetch_ctx_t;
+
+static void onStatus(void *ctx, int status)
+{
+  ((hub_fetch_ctx_t *)ctx)->status = status;
+}
+
+static void onBody(void *ctx, const uint8_t *data, size_t len)
+{
+  weatherParserFeed(&((hub_fetch_ctx_t *)ctx)->parser, data, len);
+}
+
+static bool copyField(char *dst, size_t size, const char *src, size_t len)
+{
+  if (len == 0 || len >= size) {
+    return false;
+  }
+  memcpy(dst, src, len);
+  dst[len] = '\0';
+  return true;
+}
+
+// "lat,lon;lat,lon;..." into locations[]
+static void parseLocations(void)
+{
+  const char *p = CONFIG_HUB_LOCATIONS;
+  while (*p && locationCount < HUB_LOCATIONS) {
+    const char *end = p + strcspn(p, ";");
+    const char *comma = memchr(p, ',', end - p);
+    hub_location_t *loc = &locations[locationCount];
+    if (comma && copyField(loc->lat, sizeof(loc->lat), p, comma - p) &&
+        copyField(loc->lon, sizeof(loc->lon), comma + 1, end - comma - 1)) {
+      ESP_LOGI("HUB", "location %u: %s,%s", (unsigned)locationCount, loc->lat, loc->lon);
+      locationCount++;
+    } else {
+      ESP_LOGW("HUB", "skipping bad location \"%.*s\"", (int)(end - p), p);
+    }
+    p = *end ? end + 1 : end;
+  }
+}
+
+// Every location in one batch on one connection. True if they all came back good.
+static bool fetchAll(void)
+{
+  const size_t perLocation = FETCHES_PER_LOCATION;
+  size_t count = locationCount * perLocation;
+  hub_fetch_ctx_t *ctx = arenaCalloc(count, sizeof(*ctx));
+  http_fetch_t *fetches = arenaCalloc(count, sizeof(*fetches));
+  weather_snapshot_t *snaps = arenaCalloc(locationCount, sizeof(*snaps));
+  if (!ctx || !fetches || !snaps) {
+    ESP_LOGE("HUB", "no memory for %u fetches", (unsigned)count);
+    arenaFree(snaps);
+    arenaFree(fetches);
+    arenaFree(ctx);
+    return false;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    size_t loc = i / perLocation;
+    bool air = i % perLocation;
+    if (air) {
+      weatherAirParserInit(&ctx[i].parser, &snaps[loc], NULL, NULL);
+    } else {
+      weatherParserInit(&ctx[i].parser, &snaps[loc], NULL, NULL);
+    }
+    fetches[i] = (http_fetch_t){
+        .endpoint = air ? HTTP_ENDPOINT_AIR : HTTP_ENDPOINT_FORECAST,
+        .lat = locations[loc].lat,
+        .lon = locations[loc].lon,
+        .cb = {.onStatus = onStatus, .onBody = onBody, .ctx = &ctx[i]},
+    };
+  }
+  httpFetch(fetches, count);
+  httpPoolClose();
+
+  bool allGood = true;
+  for (size_t loc = 0; loc < locationCount; loc++) {
+    hub_fetch_ctx_t *forecast = &ctx[loc * perLocation];
+    if (fetches[loc * perLocation].result != ESP_OK || forecast->status != 200 ||
+        !weatherParserFinish(&forecast->parser)) {
+      // Keep broadcasting the last good one
+      ESP_LOGW("HUB", "location %u: fetch failed (status %d)", (unsigned)loc, forecast->status);
+      allGood = false;
+      continue;
+    }
+    if (perLocation == 2) {
+      hub_fetch_ctx_t *air = &ctx[loc * perLocation + 1];
+      if (fetches[loc * perLocation + 1].result != ESP_OK || air->status != 200 ||
+          !weatherParserFinish(&air->parser)) {
+        snaps[loc].aqi = 0;
+      }
+    }
+
+    uint8_t frame[SNAPSHOT_FRAME_MAX];
+    size_t len = snapshotEncode(&snaps[loc], loc, frame, sizeof(frame));
+    if (len) {
+      memcpy(frames[loc], frame, len);
+      frameLen[loc] = len;
+    }
+    ESP_LOGI("HUB", "location %u: %u byte frame", (unsigned)loc, (unsigned)len);
+  }
+
+  // The hub never sleeps, so give back exactly what this refresh took, the TLS config included.
+  // A reset would pull the arena out from under whatever the Wi-Fi task's mbedTLS still holds.
+  tlsDeinit();
+  arenaFree(snaps);
+  arenaFree(fetches);
+  arenaFree(ctx);
+  return allGood;
+}
+
+static void broadcast(void)
+{
+  for (size_t loc = 0; loc < locationCount; loc++) {
+    if (!frameLen[loc]) {
+      continue;
+    }
+    esp_err_t err = esp_now_send(broadcastAddr, frames[loc], frameLen[loc]);
+    if (err != ESP_OK && err != ESP_ERR_ESPNOW_NO_MEM) {
+      ESP_LOGW("HUB", "send failed: %s", esp_err_to_name(err));
+    }
+    vTaskDelay(pdMS_TO_TICKS(HUB_FRAME_GAP_MS));
+  }
+}
+
+static void espnowStart(void)
+{
+  ESP_ERROR_CHECK(esp_now_init());
+  const esp_now_peer_info_t peer = {
+      .peer_addr = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+      .channel = 0,  // Whatever channel the AP put us on
+      .ifidx = WIFI_IF_STA,
+      .encrypt = false,
+  };
+  ESP_ERROR_CHECK(esp_now_add_peer(&peer));
+
+  // Nodes don't scan, they have to be set to the same channel
+  uint8_t channel;
+  wifi_second_chan_t second;
+  esp_wifi_get_channel(&channel, &second);
+  ESP_LOGI("HUB", "broadcasting %u locations on channel %u", (unsigned)locationCount, channel);
+}
+
+// Mains powered, so a lost connection just starts over
+static void restart(const char *why)
+{
+  ESP_LOGE("HUB", "%s, restarting in %d s", why, CONFIG_REFRESH_RETRY_SEC);
+  vTaskDelay(pdMS_TO_TICKS(CONFIG_REFRESH_RETRY_SEC * 1000));
+  esp_restart();
+}
+
+void hubRun(void)
+{
+  parseLocations();
+  if (locationCount == 0) {
+    restart("no locations configured");
+  }
+
+  wifiStart();
+  if (!wifiWaitConnected()) {
+    restart("Wi-Fi failed");
+  }
+  // Stay on the channel and keep the radio listening, nodes rely on hearing us
+  esp_wifi_set_ps(WIFI_PS_NONE);
+  espnowStart();
+
+  int64_t nextFetchUs = 0;
+  for (;;) {
+    if (wifiGetState() != WIFI_STATE_CONNECTED) {
+      restart("lost Wi-Fi");
+    }
+    if (esp_timer_get_time() >= nextFetchUs) {
+      bool ok = fetchAll();
+      nextFetchUs = esp_timer_get_time() + (ok ? REFRESH_INTERVAL_US : REFRESH_RETRY_US);
+    }
+    broadcast();
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_HUB_BEACON_MS));
+  }
+}
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Working memory for one refresh (HTTP and TLS buffers, inflater, parser state), carved out of a
+// block reserved at link time instead of coming and going on the heap. Allocation just bumps a
+// pointer; a free only gives memory back once everything above it has been freed too, which is
+// how handshake and request scratch tends to be released anyway. arenaReset() drops the lot at
+// the end of the cycle.
+
+// 8 byte aligned, NULL once the arena is full
+void *arenaAlloc(size_t size);
+
+void *arenaCalloc(size_t n, size_t size);
+
+// NULL is fine (like free())
+void arenaFree(void *ptr);
+
+// Whether ptr came from the arena
+bool arenaOwns(const void *ptr);
+
+void arenaReset(void);
+
+size_t arenaCapacity(void);
+
+// Bytes in use now, and the most that have ever been in use at once (headers included), for
+// sizing CONFIG_ARENA_SIZE
+size_t arenaUsed(void);
+size_t arenaHighWater(void);
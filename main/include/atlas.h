@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "framebuffer.h"
+#include "weather.h"
+
+// Fonts and icons packed into flash at build time by tools/genAtlas.py (from main/assets), so
+// drawing them is just a blit
+
+typedef struct {
+  uint16_t offset;  // Into the font's bitmap
+  uint8_t width;
+  uint8_t height;
+  uint8_t stride;   // Bytes per row
+  int8_t top;       // First row relative to the baseline, negative is above it
+  uint8_t advance;  // Pen movement, spacing included
+} glyph_t;
+
+typedef struct {
+  const uint8_t *bitmap;
+  const glyph_t *glyphs;
+  uint8_t first;  // Character code of glyphs[0]
+  uint8_t count;
+  uint8_t ascent;
+  uint8_t lineHeight;
+} font_t;
+
+// The fonts have a degree sign where DEL would be
+#define ATLAS_DEGREE "\x7f"
+
+// 14, 21 and 42 pixel cap heights
+extern const font_t fontSmall;
+extern const font_t fontMedium;
+extern const font_t fontLarge;
+
+// 32 and 64 pixel square, indexed by weather_condition_t
+extern const bitmap_t iconsSmall[WEATHER_COND_COUNT];
+extern const bitmap_t iconsLarge[WEATHER_COND_COUNT];
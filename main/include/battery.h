@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+#if CONFIG_BATTERY_MONITOR
+
+// Battery voltage in mV, from a handful of averaged ADC samples. 0 if the ADC couldn't be read.
+uint16_t batteryReadMv(void);
+
+#else
+
+static inline uint16_t batteryReadMv(void)
+{
+  return 0;
+}
+
+#endif
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Just enough of a CBOR (RFC 8949) encoder for telemetry: definite length arrays and maps,
+// integers and byte strings, written into a caller supplied buffer. Containers take their item
+// count up front, the items then follow as ordinary calls.
+typedef struct {
+  uint8_t *buf;
+  size_t size;
+  size_t len;
+  bool overflow;  // Something didn't fit, the output is unusable
+} cbor_writer_t;
+
+void cborInit(cbor_writer_t *w, uint8_t *buf, size_t size);
+
+void cborUint(cbor_writer_t *w, uint64_t value);
+void cborInt(cbor_writer_t *w, int64_t value);
+void cborBytes(cbor_writer_t *w, const void *data, size_t len);
+void cborArray(cbor_writer_t *w, size_t count);
+void cborMap(cbor_writer_t *w, size_t pairs);
+
+// Encoded length, or 0 if it overflowed
+static inline size_t cborLength(const cbor_writer_t *w)
+{
+  return w->overflow ? 0 : w->len;
+}
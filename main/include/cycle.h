@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RTC_STATE_MAGIC 0x57445331  // "WDS1"
+
+// State that survives deep sleep (lives in RTC slow memory)
+typedef struct {
+  uint32_t magic;
+  uint32_t bootCount;
+  uint32_t snapshotHash;     // FNV-1a of the last snapshot we rendered
+  uint8_t wifiFailures;      // consecutive cycles that never got an IP
+  uint8_t fetchFailures;     // consecutive cycles where the HTTP fetch failed
+  uint8_t partialRefreshes;  // partial refreshes since the last full one
+  bool offline;              // the panel shows the kept forecast, advanced, for want of a fetch
+  int64_t nextWakeUs;        // cycleNowUs() time this wake was scheduled for
+} rtc_state_t;
+
+extern rtc_state_t rtcState;
+
+typedef enum {
+  CYCLE_WAKE_COLD,    // Power on or reset, RTC state was reset
+  CYCLE_WAKE_TIMER,   // The planned refresh
+  CYCLE_WAKE_BUTTON,  // Someone pressed the wake button (CONFIG_WAKE_BUTTON)
+} cycle_wake_t;
+
+// Validate the RTC state and say what woke us. Only a cold boot touches NVS.
+cycle_wake_t cycleInit(void);
+
+// Bring NVS up the first time something needs it, so wakes that don't never pay for it
+void cycleNvsInit(void);
+
+// The planned refresh is close enough (or the last one failed) that this wake should do it
+bool cycleRefreshDue(void);
+
+// Microseconds on a clock that keeps running through deep sleep (reset on power loss)
+int64_t cycleNowUs(void);
+
+// Record the hash of what's now on the panel (RTC, and NVS for cold boots)
+void cycleSetSnapshotHash(uint32_t hash);
+
+// Program the wake-up timer for the next refresh (see schedule.h) and enter deep sleep (never
+// returns)
+void cycleSleep(void);
+
+// Back to deep sleep until the refresh that was already planned, after a wake that wasn't one
+// (never returns)
+void cycleResume(void);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "framebuffer.h"
+
+// The frame to render into. When restore is set and the last frame shown could be restored it's
+// already in there, so only what changed needs drawing; otherwise it's blank and the next show is
+// a full refresh. *current says which.
+framebuffer_t *displayFrame(bool restore, bool *current);
+
+// Put the frame on the panel. When the panel's current image is known only the pixels that differ
+// from it (within dirty) are refreshed, if the region is small enough, with a full refresh every
+// so often to clear ghosting.
+esp_err_t displayShow(const framebuffer_t *fb, const fb_rect_t *dirty);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "lwip/sockets.h"
+
+// Resolve an IPv4 address for host. A cached answer younger than the TTL is returned without
+// touching the network. An expired one is still returned straight away, and a background lookup
+// refreshes it for next time. Only a host we've never resolved waits on DNS, and only until
+// deadlineUs (esp_timer time), ESP_ERR_TIMEOUT after that. *cached (optional) tells the caller
+// whether the answer came from the cache.
+esp_err_t dnsResolve(const char *host, struct in_addr *addr, bool *cached, int64_t deadlineUs);
+
+// The cached address for host didn't work, the next dnsResolve() does a real lookup
+void dnsInvalidate(const char *host);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "esp_err.h"
+#include "framebuffer.h"
+
+// Set up the SPI bus and control pins. Doesn't talk to the panel, so it's cheap enough to run
+// while Wi-Fi is still associating.
+esp_err_t epdInit(void);
+
+// Wake the panel, stream the frame out and run a full refresh. Returns once the panel has
+// finished (BUSY released) and gone back to deep sleep.
+esp_err_t epdDisplay(const framebuffer_t *fb);
+
+#if CONFIG_EPD_PARTIAL_REFRESH
+// Like epdDisplay() but only refreshes rect (x and width multiples of 8). prev has to be what's
+// on the panel right now, the controller needs both to drive just the changed pixels.
+esp_err_t epdDisplayPartial(const framebuffer_t *fb, const framebuffer_t *prev,
+                            const fb_rect_t *rect);
+#endif
+
+// Put the controller into deep sleep (a reset is needed to wake it)
+void epdSleep(void);
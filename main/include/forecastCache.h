@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "weather.h"
+
+// The last few forecasts that came in whole, kept in NVS for when the network isn't there. Each
+// is a snapshot frame (snapshotCodec.h) under its own key, written round robin so one bad
+// record never costs more than itself.
+
+// Keep snap as the newest record
+void forecastCacheSave(const weather_snapshot_t *snap);
+
+// The newest record that still reaches now (unix seconds), advanced to it with
+// snapshotAdvance(). Returns false if none does.
+bool forecastCacheLoad(uint32_t now, weather_snapshot_t *out);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Run-length coding of a bit plane XORed against a reference plane: NULL for a blank (white)
+// reference, which makes it a plain compressor, or the previous frame for a delta where only
+// the changed bytes are non-zero. Tokens are byte aligned so decoding is memset, memcpy and XOR:
+//
+//   0x00-0x7F  literal, (t + 1) bytes follow
+//   0x80-0xBF  (t & 0x3F) + 1 zero bytes
+//   0xC0-0xFF  ((t & 0x3F) << 8 | next byte) + 65 zero bytes
+
+// Receives the encoded stream as it's produced, in pieces of at most a few hundred bytes
+typedef void (*frame_sink_t)(void *ctx, const uint8_t *data, size_t len);
+
+// Encode n bytes of plane, as its XOR against ref (may be NULL). sink may be NULL to only measure.
+// Returns the encoded length.
+size_t frameEncode(const uint8_t *plane, const uint8_t *ref, size_t n, frame_sink_t sink,
+                   void *ctx);
+
+// Decode one plane of n bytes from in, XORing with ref on the way (may be NULL, or plane itself to
+// apply a delta in place). Returns the bytes of in used, 0 if it's malformed or runs short.
+size_t frameDecode(const uint8_t *in, size_t len, const uint8_t *ref, uint8_t *plane, size_t n);
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "framebuffer.h"
+
+// The frame currently on the panel, kept compressed (frameCodec.h) in a ring of records in its own
+// flash partition so partial refreshes can diff against it after deep sleep (or a power cycle,
+// the panel keeps its image either way)
+bool frameStoreLoad(framebuffer_t *fb);
+
+// fb is now on the panel. prev is what was there before, as frameStoreLoad() gave it, or NULL if
+// that's not known. With prev the frame is usually stored as just what changed.
+esp_err_t frameStoreSave(const framebuffer_t *fb, const framebuffer_t *prev);
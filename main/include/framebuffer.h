@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+// 7.5" Waveshare panel (UC8179 controller), landscape
+#define FB_WIDTH 800
+#define FB_HEIGHT 480
+
+// The controller takes each bit plane as rows of MSB-first bytes, top row first, so that's
+// exactly how we store them. A frame goes out with a straight memcpy-free DMA of each plane.
+#define FB_STRIDE (FB_WIDTH / 8)
+#define FB_PLANE_SIZE (FB_STRIDE * FB_HEIGHT)
+
+#if CONFIG_EPD_GREYSCALE
+#define FB_BPP 2
+#else
+#define FB_BPP 1
+#endif
+#define FB_PLANES FB_BPP
+#define FB_SIZE (FB_PLANE_SIZE * FB_PLANES)
+
+// Pixel values. With 2bpp, bit 0 of the level lives in plane 0 and bit 1 in plane 1.
+#define FB_WHITE 0
+#define FB_BLACK ((1 << FB_BPP) - 1)
+#if FB_BPP == 2
+#define FB_LIGHT_GREY 1
+#define FB_DARK_GREY 2
+#else
+#define FB_LIGHT_GREY FB_WHITE
+#define FB_DARK_GREY FB_BLACK
+#endif
+
+typedef struct {
+  uint8_t *planes[FB_PLANES];
+} framebuffer_t;
+
+typedef struct {
+  int16_t x;
+  int16_t y;
+  int16_t w;
+  int16_t h;
+} fb_rect_t;
+
+// 1bpp image, rows of MSB-first bytes like a plane. Set bits are ink, padding bits past width
+// must be clear.
+typedef struct {
+  const uint8_t *data;
+  uint16_t width;
+  uint16_t height;
+  uint8_t stride;  // Bytes per row
+} bitmap_t;
+
+// Wrap caller memory (FB_SIZE bytes, word aligned) as a framebuffer
+void fbInit(framebuffer_t *fb, uint8_t *mem);
+
+// The frame the display driver sends. Statically allocated in DMA capable memory so it's never
+// on the heap.
+framebuffer_t *fbMain(void);
+
+#if CONFIG_EPD_PARTIAL_REFRESH
+// Scratch frame for what's currently on the panel (in PSRAM when the board has it)
+framebuffer_t *fbPrevious(void);
+#endif
+
+void fbClear(framebuffer_t *fb, uint8_t color);
+
+// Rectangles go a 32 pixel word at a time (raster.h), masked only at the two ends of each row
+void fbFillRect(framebuffer_t *fb, int x, int y, int w, int h, uint8_t color);
+
+// Swap ink and paper inside the rectangle (black and white, light and dark grey)
+void fbInvertRect(framebuffer_t *fb, int x, int y, int w, int h);
+
+// Draw the set bits of bm with its top left at x,y, clear bits are left alone. Each source row is
+// shifted into place a word at a time, at any bit offset.
+void fbBlit(framebuffer_t *fb, const bitmap_t *bm, int x, int y, uint8_t color);
+
+// Bounds of every pixel that differs between a and b, false if they're the same frame
+bool fbDiff(const framebuffer_t *a, const framebuffer_t *b, fb_rect_t *changed);
+
+static inline void fbSetPixel(framebuffer_t *fb, int x, int y, uint8_t color)
+{
+  if ((unsigned)x >= FB_WIDTH || (unsigned)y >= FB_HEIGHT) {
+    return;
+  }
+  size_t ofs = (size_t)y * FB_STRIDE + (x >> 3);
+  uint8_t mask = 0x80 >> (x & 7);
+  for (int p = 0; p < FB_PLANES; p++) {
+    if (color & (1 << p)) {
+      fb->planes[p][ofs] |= mask;
+    } else {
+      fb->planes[p][ofs] &= ~mask;
+    }
+  }
+}
+
+static inline uint8_t fbGetPixel(const framebuffer_t *fb, int x, int y)
+{
+  if ((unsigned)x >= FB_WIDTH || (unsigned)y >= FB_HEIGHT) {
+    return FB_WHITE;
+  }
+  size_t ofs = (size_t)y * FB_STRIDE + (x >> 3);
+  uint8_t mask = 0x80 >> (x & 7);
+  uint8_t color = 0;
+  for (int p = 0; p < FB_PLANES; p++) {
+    if (fb->planes[p][ofs] & mask) {
+      color |= 1 << p;
+    }
+  }
+  return color;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "miniz.h"
+
+// Streaming gunzip on top of the tinfl inflater in ROM. Output comes out in whatever pieces
+// the inflater produces, straight out of the 32 KB history window, and is checked against the
+// CRC32 and length in the gzip trailer at the end.
+typedef void (*gzip_output_t)(void *ctx, const uint8_t *data, size_t len);
+
+#define GZIP_DICT_SIZE TINFL_LZ_DICT_SIZE
+
+typedef struct {
+  tinfl_decompressor inflator;
+  uint8_t *dict;       // GZIP_DICT_SIZE bytes, doubles as the output buffer
+  size_t dictOfs;
+  gzip_output_t out;
+  void *ctx;
+
+  uint8_t state;       // Header/body/trailer parse state
+  uint8_t flags;       // Header FLG byte
+  uint16_t skip;       // Header bytes still to skip in the current state
+  uint8_t extraLo;     // Low byte of the FEXTRA length
+  uint32_t crc;        // Of the output so far
+  uint32_t size;       // Output bytes so far, mod 2^32 like ISIZE
+  uint8_t trailer[8];  // CRC32 and ISIZE as they came in
+  uint8_t trailerLen;
+  bool done;
+  bool failed;
+} gzip_inflater_t;
+
+void gzipInit(gzip_inflater_t *gz, uint8_t *dict, gzip_output_t out, void *ctx);
+
+// Returns false once the stream is corrupt
+bool gzipFeed(gzip_inflater_t *gz, const uint8_t *data, size_t len);
+
+// True if the deflate stream ran to completion and the output matches the trailer
+bool gzipFinish(gzip_inflater_t *gz);
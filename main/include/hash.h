@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Incremental 32-bit FNV-1a, start with FNV1A_INIT
+#define FNV1A_INIT 0x811C9DC5u
+uint32_t fnv1a(uint32_t hash, const void *data, size_t len);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "httpParser.h"
+
+// What we fetch from the weather API
+typedef enum {
+  HTTP_ENDPOINT_FORECAST,  // One Call: current conditions, hourly and daily. Conditional on the
+                           // validators kept by httpSaveValidators(), so expect a 304.
+  HTTP_ENDPOINT_AIR,       // Air pollution, for the air quality index
+} http_endpoint_t;
+
+typedef struct {
+  http_endpoint_t endpoint;
+  // Somewhere other than the configured location (decimal degrees), NULL for that. Forecasts for
+  // other locations are never conditional.
+  const char *lat;
+  const char *lon;
+  http_callbacks_t cb;
+  esp_err_t result;  // ESP_OK once the whole response was parsed, whatever its status code
+} http_fetch_t;
+
+// Send every request on one keep-alive connection to the API (reused from earlier fetches this
+// wake when there is one) back to back, then stream each response through its own callbacks in
+// order. One handshake however many endpoints. Returns ESP_OK if every fetch got a complete
+// response, see the individual results otherwise.
+esp_err_t httpFetch(http_fetch_t *fetches, size_t count);
+
+// Close the pooled connections, keeping TLS sessions for the next wake. Call before Wi-Fi stops.
+void httpPoolClose(void);
+
+// The last forecast response was parsed and used, keep its ETag/Last-Modified for the next
+// request
+void httpSaveValidators(void);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+// Longest status/header/chunk-size line we keep, anything past this is dropped
+#ifndef CONFIG_HTTP_LINE_BUF_SIZE
+#define CONFIG_HTTP_LINE_BUF_SIZE 256
+#endif
+
+typedef struct {
+  // Called once the status line is parsed
+  void (*onStatus)(void *ctx, int status);
+  // Called per header, name is lower case and both strings are NUL terminated
+  void (*onHeader)(void *ctx, const char *name, const char *value);
+  // Called with each slice of (de-chunked) body as it arrives, points into the caller's buffer
+  void (*onBody)(void *ctx, const uint8_t *data, size_t len);
+  void *ctx;
+} http_callbacks_t;
+
+typedef enum {
+  HTTP_PARSE_STATUS,
+  HTTP_PARSE_HEADERS,
+  HTTP_PARSE_BODY,        // Content-Length or read-until-close body
+  HTTP_PARSE_CHUNK_SIZE,
+  HTTP_PARSE_CHUNK_DATA,
+  HTTP_PARSE_CHUNK_END,   // CRLF after chunk data
+  HTTP_PARSE_TRAILERS,
+  HTTP_PARSE_DONE,
+  HTTP_PARSE_ERROR,
+} http_parse_state_t;
+
+// Incremental HTTP/1.x response parser. Works on whatever slices the socket hands us, never
+// buffers the body and only keeps one header line around at a time.
+typedef struct {
+  http_callbacks_t cb;
+  http_parse_state_t state;
+  int status;
+  bool chunked;
+  bool hasLength;     // Content-Length seen, otherwise the body runs until the peer closes
+  uint64_t remaining; // Bytes left in the body (or the current chunk)
+  size_t lineLen;
+  bool lineOverflow;
+  char line[CONFIG_HTTP_LINE_BUF_SIZE];
+} http_parser_t;
+
+void httpParserInit(http_parser_t *parser, const http_callbacks_t *cb);
+
+// Prepare for the next response on the same connection, keeps the callbacks
+void httpParserReset(http_parser_t *parser);
+
+// Feed received bytes. Returns how many were consumed, which is less than len only once the
+// response is complete (the rest belongs to the next response) or on a parse error.
+size_t httpParserFeed(http_parser_t *parser, const uint8_t *data, size_t len);
+
+// Tell the parser the peer closed the connection, completes a read-until-close body
+void httpParserFinish(http_parser_t *parser);
+
+static inline bool httpParserDone(const http_parser_t *parser)
+{
+  return parser->state == HTTP_PARSE_DONE;
+}
+
+static inline bool httpParserFailed(const http_parser_t *parser)
+{
+  return parser->state == HTTP_PARSE_ERROR;
+}
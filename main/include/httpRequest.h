@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Builds an HTTP/1.1 request into a caller supplied buffer, no allocation. Calls go in order:
+// begin, any number of query params, any number of headers, end.
+typedef struct {
+  char *buf;
+  size_t size;
+  size_t len;
+  const char *host;
+  bool inQuery;     // Still building the request target
+  bool hasQuery;
+  bool overflow;
+} http_request_t;
+
+void httpRequestBegin(http_request_t *req, char *buf, size_t size, const char *method,
+                      const char *host, const char *path);
+
+// Appends ?name=value or &name=value, value is percent-encoded
+void httpRequestQuery(http_request_t *req, const char *name, const char *value);
+
+void httpRequestHeader(http_request_t *req, const char *name, const char *value);
+
+// Terminates the header block. Returns the request length, or 0 if it didn't fit.
+size_t httpRequestEnd(http_request_t *req);
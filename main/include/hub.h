@@ -0,0 +1,14 @@
+#pragma once
+
+#include "sdkconfig.h"
+
+// Hub mode: one mains powered board fetches the forecast for every display in the building in a
+// single batch, and keeps broadcasting the parsed snapshots over ESP-NOW (see snapshotCodec.h)
+// for battery nodes to pick up. Nodes never associate, resolve, handshake or parse JSON.
+
+#if CONFIG_DEVICE_ROLE_HUB
+
+// Fetch and broadcast forever (mains powered, never sleeps). Call instead of the display cycle.
+void hubRun(void) __attribute__((noreturn));
+
+#endif
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+// Deepest nesting we track, anything deeper is a parse error
+#ifndef CONFIG_JSON_MAX_DEPTH
+#define CONFIG_JSON_MAX_DEPTH 8
+#endif
+
+// Longest string/number token kept, longer ones are truncated (and flagged)
+#ifndef CONFIG_JSON_TOKEN_MAX
+#define CONFIG_JSON_TOKEN_MAX 32
+#endif
+
+// Key id for any member name that isn't in the parser's key table
+#define JSON_KEY_OTHER 0
+
+typedef enum {
+  JSON_NULL,
+  JSON_BOOL,
+  JSON_NUMBER,
+  JSON_STRING,
+  JSON_OBJECT_BEGIN,
+  JSON_OBJECT_END,
+  JSON_ARRAY_BEGIN,
+  JSON_ARRAY_END,
+} json_event_t;
+
+// One open object/array
+typedef struct {
+  uint8_t isArray;
+  uint8_t key;     // Objects: id of the member currently being parsed
+  uint16_t index;  // Arrays: index of the element currently being parsed
+} json_frame_t;
+
+typedef struct json_parser json_parser_t;
+
+// Called for every value and container boundary. For scalars text/len is the raw token (string
+// contents are unescaped). The path to the value is available through jsonDepth()/jsonFrame().
+typedef void (*json_callback_t)(void *ctx, const json_parser_t *parser, json_event_t event,
+                                const char *text, size_t len);
+
+// Streaming (SAX style) JSON tokenizer. Fed arbitrary slices, keeps only a tiny fixed state and
+// never allocates. Member names are mapped to small ids through a caller supplied table so the
+// consumer can match paths with integer compares.
+struct json_parser {
+  json_callback_t cb;
+  void *ctx;
+  const char *const *keys;  // keys[i] has id i + 1
+  uint8_t keyCount;
+
+  uint8_t state;
+  uint8_t depth;
+  bool failed;
+  bool isKey;        // Current string is a member name
+  bool tokOverflow;  // Current token didn't fit in tok
+  uint8_t escLeft;   // \uXXXX digits still to skip
+  uint8_t tokLen;
+  char tok[CONFIG_JSON_TOKEN_MAX + 1];
+  json_frame_t stack[CONFIG_JSON_MAX_DEPTH];
+};
+
+void jsonParserInit(json_parser_t *parser, const char *const *keys, uint8_t keyCount,
+                    json_callback_t cb, void *ctx);
+
+// Returns false once the document is malformed, further input is ignored
+bool jsonParserFeed(json_parser_t *parser, const uint8_t *data, size_t len);
+
+// True if exactly one complete top level value was parsed
+bool jsonParserFinish(json_parser_t *parser);
+
+static inline uint8_t jsonDepth(const json_parser_t *parser)
+{
+  return parser->depth;
+}
+
+static inline const json_frame_t *jsonFrame(const json_parser_t *parser, uint8_t level)
+{
+  return &parser->stack[level];
+}
+
+// Non-NUL-terminated token helpers
+int32_t jsonToFixed(const char *text, size_t len, uint8_t decimals);
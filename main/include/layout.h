@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "framebuffer.h"
+#include "weather.h"
+
+// Start a new frame. current says fb already holds the last committed frame, otherwise every
+// widget gets drawn.
+void layoutBegin(bool current);
+
+// Draw the widgets bound to sections (a weather_section_t mask) whose data changed. Can be called
+// again as more of the snapshot arrives, widgets are only redrawn if their data changed again.
+void layoutRender(framebuffer_t *fb, const weather_snapshot_t *snap, uint32_t sections);
+
+// Streaming alternative to layoutRender(): hand over fields straight from the parser, each widget
+// is drawn a cell at a time as its data completes. Only the cell being filled in is kept, never a
+// snapshot. Same results as layoutRender(), section end fields included.
+void layoutField(framebuffer_t *fb, const weather_field_t *field);
+
+// Union of the widgets that now differ from what fb held at layoutBegin() (byte aligned, ready for
+// a partial refresh). Returns false if nothing needs showing.
+bool layoutDirty(fb_rect_t *dirty);
+
+// The frame made it onto the panel, remember what it showed
+void layoutCommit(void);
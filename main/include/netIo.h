@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lwip/sockets.h"
+
+// Non-blocking socket I/O where every wait is bounded by one absolute deadline (esp_timer
+// microseconds) for the whole exchange, rather than a timeout per call.
+
+// Deadline ms from now
+int64_t netDeadline(uint32_t ms);
+
+// Open a non-blocking socket connected to dest. -1 on failure or once the deadline passes.
+int netConnect(const struct sockaddr_in *dest, int64_t deadlineUs);
+
+// Block until fd is readable (or writable), false if the deadline passed first
+bool netWait(int fd, bool write, int64_t deadlineUs);
+
+// Bytes read, 0 when the peer closed, negative on an error or the deadline
+int netRead(int fd, void *buf, size_t len, int64_t deadlineUs);
+
+// Writes all of buf, returns len or negative on an error or the deadline
+int netWrite(int fd, const void *buf, size_t len, int64_t deadlineUs);
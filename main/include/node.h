@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "sdkconfig.h"
+#include "weather.h"
+
+// Node mode: a display that gets its forecast from a hub (see hub.h) instead of the internet.
+// The radio comes up without associating, listens on the hub's channel for a frame with this
+// node's location, and goes straight back off.
+
+#if CONFIG_DEVICE_ROLE_NODE
+
+// Listen for up to CONFIG_NODE_LISTEN_MS. True with out filled in if a valid frame for
+// CONFIG_NODE_LOCATION arrived. The radio is stopped again either way.
+bool nodeReceive(weather_snapshot_t *out);
+
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+// Where awake time goes. Each stage accumulates the time between its probeBegin()/probeEnd()
+// pairs (a stage can run more than once a cycle, e.g. SPI per plane), and probeFinish() folds
+// the lot into one record per cycle kept in an RTC memory ring.
+typedef enum {
+  PROBE_BOOT,        // Reset to app_main
+  PROBE_WIFI_ASSOC,  // Wi-Fi bring-up to associated, retries included
+  PROBE_DHCP,        // Associated to IP
+  PROBE_DNS,
+  PROBE_TCP,         // connect()
+  PROBE_TLS,         // Handshake
+  PROBE_FIRST_BYTE,  // Request sent to the first byte of the response
+  PROBE_BODY,        // First byte to the end of the response
+  PROBE_PARSE,       // JSON parsing, inside PROBE_BODY
+  PROBE_RENDER,      // Drawing into the framebuffer
+  PROBE_SPI,         // Frame data out to the panel
+  PROBE_BUSY,        // Waiting on the panel to finish refreshing
+  PROBE_LISTEN,      // Radio on waiting for the hub (nodes only)
+  PROBE_INIT,        // app_main to the radio starting (or the redraw starting, with no radio)
+  PROBE_COUNT,
+} probe_id_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t cycle;    // rtcState.bootCount
+  uint16_t awakeMs;  // Reset to deep sleep
+  uint16_t shownMs;  // Reset to the end of the last panel refresh, 0 if there wasn't one
+  uint16_t stageMs[PROBE_COUNT];
+  uint32_t rxBytes;    // Response bytes read, after TLS and before gzip
+  uint16_t batteryMv;  // 0 without a battery monitor
+  int8_t rssi;         // dBm of the AP we associated with, 0 if we never did
+  uint8_t retries;     // Wi-Fi reconnects plus TCP reconnects
+} probe_record_t;
+
+#if CONFIG_CYCLE_PROBES
+
+// Call first thing in app_main
+void probeInit(void);
+
+void probeBegin(probe_id_t id);
+void probeEnd(probe_id_t id);
+
+// Cycle counters that go into the record next to the stage times
+void probeAddRx(size_t bytes);
+void probeAddRetry(void);
+void probeSetRssi(int8_t rssi);
+void probeSetBattery(uint16_t mv);
+
+// Close the cycle's record, log it and push it into the ring. Call just before sleeping.
+void probeFinish(uint32_t cycle);
+
+// Records kept across deep sleep, age 0 is the newest. NULL past the oldest.
+const probe_record_t *probeHistory(size_t age);
+
+#else
+
+static inline void probeInit(void) {}
+static inline void probeBegin(probe_id_t id) {}
+static inline void probeEnd(probe_id_t id) {}
+static inline void probeAddRx(size_t bytes) {}
+static inline void probeAddRetry(void) {}
+static inline void probeSetRssi(int8_t rssi) {}
+static inline void probeSetBattery(uint16_t mv) {}
+static inline void probeFinish(uint32_t cycle) {}
+static inline const probe_record_t *probeHistory(size_t age)
+{
+  return NULL;
+}
+
+#endif
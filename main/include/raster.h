@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "framebuffer.h"
+
+// Word-parallel kernels on 1bpp planes: 32 pixels per load and store, with masks only for the
+// partial words at either end. Rows are MSB-first bytes like a panel plane and have to start on
+// a 4 byte boundary (FB_STRIDE is a multiple of 4, and planes are word aligned).
+
+typedef enum {
+  RASTER_CLEAR,
+  RASTER_SET,
+  RASTER_INVERT,
+} raster_op_t;
+
+// Apply op to pixels [x0, x1) of row
+void rasterSpan(uint8_t *row, int x0, int x1, raster_op_t op);
+
+// Draw the set bits of a width pixel source row (MSB-first, padding bits clear, any alignment)
+// into row starting at pixel x, where x + width fits in the row. Clear bits are left alone.
+void rasterBlit(uint8_t *row, int x, const uint8_t *src, int width, bool set);
+
+// Smallest rectangle holding every pixel that differs between two FB_WIDTH x FB_HEIGHT planes.
+// Returns false, leaving *bounds alone, if they're identical.
+bool rasterDiff(const uint8_t *a, const uint8_t *b, fb_rect_t *bounds);
+
+// Turn a width x height plane upside down in place, width a multiple of 32
+void rasterRotate180(uint8_t *plane, int width, int height);
+
+// Rotate a width x height plane a quarter turn clockwise into dst, which comes out height x width
+// (a portrait frame drawn at 480x800 lands on the 800x480 panel). Both multiples of 32.
+void rasterRotate90(const uint8_t *src, int width, int height, uint8_t *dst);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "weather.h"
+
+// Rendering and the display driver run on their own task on the other core, fed snapshot
+// sections as the forecast streams in, so drawing overlaps with the rest of the download.
+
+// Bring the panel driver up and restore the last frame. Call early, it overlaps with Wi-Fi. With
+// blank the frame starts empty instead, so everything is drawn and shown with a full refresh.
+void renderStart(bool blank);
+
+// sections (a weather_section_t mask) of snap are complete and can be drawn. snap is copied.
+void renderSection(const weather_snapshot_t *snap, uint32_t sections);
+
+// Streaming instead of sections (CONFIG_RENDER_STREAMING): one parsed field, see layoutField()
+void renderField(const weather_field_t *field);
+
+// End the cycle: put what was drawn on the panel if show, or throw it away. Blocks until the
+// render task is done, returns the display result (ESP_OK if nothing needed showing).
+esp_err_t renderFinish(bool show);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// When to wake next. The device has no wall clock of its own, so the forecast response's Date
+// header sets one (kept in RTC memory as an offset from cycleNowUs()). From there the next wake
+// goes, in order of preference, to when Cache-Control/Expires say the response goes stale, or one
+// upstream update period after the observation time, or the fixed refresh interval. It's
+// pushed past quiet hours and stretched when the battery is low.
+
+// A forecast response header (lower case name), before the response is known to be usable
+void scheduleHeader(const char *name, const char *value);
+
+// The forecast response the headers came with was used, 200 or 304
+void scheduleCommit(void);
+
+// Observation time (unix seconds) and UTC offset of the forecast now on the panel
+void scheduleSetData(uint32_t time, int32_t tzOffset);
+
+// Battery voltage in mV for this wake, 0 if unknown
+void scheduleSetBattery(uint16_t mv);
+
+typedef enum {
+  SCHEDULE_NORMAL,
+  SCHEDULE_RETRY,    // The cycle failed, try again soon
+  SCHEDULE_OFFLINE,  // The cycle failed but the kept forecast is on the panel, so no hurry
+} schedule_mode_t;
+
+// The next wake on the cycleNowUs() clock. scheduledUs is when this wake was due.
+int64_t scheduleNextWake(int64_t nowUs, int64_t scheduledUs, schedule_mode_t mode);
+
+// Unix time now, from the last Date header. 0 if there hasn't been one since power on.
+uint32_t scheduleNow(void);
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "weather.h"
+
+// Bring a kept forecast forward to now (unix seconds) for showing without a fetch: the current
+// conditions come from the hourly entry now falls in, and hours and days already gone are
+// dropped. The observation time stays as it was, so the panel still says how old the data is.
+// Returns false if now is past the end of the hourly forecast or before its start.
+bool snapshotAdvance(const weather_snapshot_t *from, uint32_t now, weather_snapshot_t *out);
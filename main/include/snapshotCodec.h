@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "weather.h"
+
+// Wire format for a snapshot sent from a hub to its nodes, sized for a single ESP-NOW frame.
+// A 4 byte header (magic, version, location index), then the snapshot with temperatures as
+// zigzag varint tenths of a degree, hourly and daily values as deltas from the entry before,
+// and conditions packed two to a byte. Little endian where fixed width.
+
+#define SNAPSHOT_FRAME_MAGIC0 'W'
+#define SNAPSHOT_FRAME_MAGIC1 'D'
+#define SNAPSHOT_FRAME_VERSION 1
+#define SNAPSHOT_FRAME_HEADER 4
+
+// Largest frame we send or accept, ESP_NOW_MAX_DATA_LEN
+#define SNAPSHOT_FRAME_MAX 250
+
+// Encode snap for location into buf. Hourly entries are dropped from the end until it fits in
+// size. Returns the frame length, 0 if not even the current conditions fit.
+size_t snapshotEncode(const weather_snapshot_t *snap, uint8_t location, uint8_t *buf,
+                      size_t size);
+
+// Check and decode a frame. Returns false, with out left in an unspecified state, if it isn't a
+// well formed frame of this version.
+bool snapshotDecode(const uint8_t *buf, size_t len, uint8_t *location, weather_snapshot_t *out);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "sdkconfig.h"
+
+// Cycle records (stage times, retries, RSSI, bytes received, battery) batched up and POSTed as
+// CBOR to a collector, for tracking energy per refresh across devices.
+//
+// Batch layout, a map with small integer keys:
+//   0: format version (1)
+//   1: station MAC (6 byte string)
+//   2: records, oldest first, each
+//      [cycle, awakeMs, retries, rssi, batteryMv, rxBytes, [stageMs in probe_id_t order]]
+
+#if CONFIG_TELEMETRY
+
+// Upload the records the collector hasn't had yet, once there are CONFIG_TELEMETRY_BATCH of
+// them. Only call with the network up, it rides on the association the fetch has already paid
+// for. Records that don't make it stay pending for the next wake.
+void telemetrySend(void);
+
+#else
+
+static inline void telemetrySend(void) {}
+
+#endif
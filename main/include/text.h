@@ -0,0 +1,10 @@
+#pragma once
+
+#include "atlas.h"
+#include "framebuffer.h"
+
+// Draw a string with the pen starting at x on baseline y. Characters the font doesn't have are
+// skipped. Returns the pen position after the last character.
+int textDraw(framebuffer_t *fb, const font_t *font, int x, int y, const char *text, uint8_t color);
+
+int textWidth(const font_t *font, const char *text);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/ssl.h"
+
+typedef struct {
+  mbedtls_net_context net;
+  mbedtls_ssl_context ssl;
+  int64_t deadlineUs;  // Nothing on this connection waits past this (esp_timer time)
+} tls_conn_t;
+
+// Handshake over an already connected, non-blocking socket. Resumes the session saved by the
+// last tlsClose() when there is one (it survives deep sleep), otherwise does a full handshake.
+// Every read, write and the handshake give up at deadlineUs.
+esp_err_t tlsConnect(tls_conn_t *conn, int fd, const char *host, int64_t deadlineUs);
+
+// Return the number of bytes read/written, 0 on a clean close, negative on error
+int tlsRead(tls_conn_t *conn, uint8_t *buf, size_t len);
+int tlsWrite(tls_conn_t *conn, const uint8_t *buf, size_t len);
+
+// Keep the session for resumption on the next wake, then tear the connection down (socket too)
+void tlsClose(tls_conn_t *conn);
+
+// Free the shared config and CA chain (they live in the cycle arena), for callers that reuse the
+// arena without sleeping in between. Close every connection first. The next tlsConnect() sets
+// them up again.
+void tlsDeinit(void);
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#ifndef CONFIG_WEATHER_HOURLY_MAX
+#define CONFIG_WEATHER_HOURLY_MAX 24
+#endif
+#ifndef CONFIG_WEATHER_DAILY_MAX
+#define CONFIG_WEATHER_DAILY_MAX 7
+#endif
+
+#define WEATHER_HOURLY_MAX CONFIG_WEATHER_HOURLY_MAX
+#define WEATHER_DAILY_MAX CONFIG_WEATHER_DAILY_MAX
+
+// What we draw an icon for, collapsed from the API's condition codes
+typedef enum {
+  WEATHER_COND_UNKNOWN,
+  WEATHER_COND_CLEAR,
+  WEATHER_COND_FEW_CLOUDS,
+  WEATHER_COND_CLOUDS,
+  WEATHER_COND_OVERCAST,
+  WEATHER_COND_DRIZZLE,
+  WEATHER_COND_RAIN,
+  WEATHER_COND_THUNDER,
+  WEATHER_COND_SNOW,
+  WEATHER_COND_MIST,
+  WEATHER_COND_COUNT,
+} weather_condition_t;
+
+// Temperatures are fixed point tenths of a degree (in whatever units were requested)
+typedef struct __attribute__((packed)) {
+  int16_t temp;
+  uint8_t condition;  // weather_condition_t
+  uint8_t pop;        // Probability of precipitation, percent
+} weather_hour_t;
+
+typedef struct __attribute__((packed)) {
+  int16_t tempMin;
+  int16_t tempMax;
+  uint8_t condition;
+  uint8_t pop;
+} weather_day_t;
+
+// Everything we render, and nothing else
+typedef struct __attribute__((packed)) {
+  uint32_t time;         // Time of the current observation (unix seconds)
+  int32_t tzOffset;      // Location's offset from UTC (seconds)
+  int16_t temp;
+  int16_t feelsLike;
+  uint8_t humidity;      // Percent
+  uint8_t condition;
+  uint8_t aqi;           // Air quality index, 1 (good) to 5 (very poor), 0 if we don't have it
+  uint8_t hourlyCount;
+  uint8_t dailyCount;
+  uint32_t hourlyStart;  // Time of hourly[0], entries are one hour apart
+  uint32_t dailyStart;   // Time of daily[0], entries are one day apart
+  weather_hour_t hourly[WEATHER_HOURLY_MAX];
+  weather_day_t daily[WEATHER_DAILY_MAX];
+} weather_snapshot_t;
+
+// Parts of a snapshot that complete separately as a forecast streams in, as a mask
+typedef enum {
+  WEATHER_SECTION_CURRENT = 1 << 0,
+  WEATHER_SECTION_HOURLY = 1 << 1,
+  WEATHER_SECTION_DAILY = 1 << 2,
+  WEATHER_SECTION_AIR = 1 << 3,  // From the air pollution response
+  WEATHER_SECTION_ALL = 0x0F,
+} weather_section_t;
+
+// One value as it comes out of the parser, for consumers that don't keep a snapshot
+typedef enum {
+  WEATHER_FIELD_TZ_OFFSET,
+  WEATHER_FIELD_TIME,
+  WEATHER_FIELD_TEMP,
+  WEATHER_FIELD_FEELS_LIKE,
+  WEATHER_FIELD_HUMIDITY,
+  WEATHER_FIELD_CONDITION,
+  WEATHER_FIELD_AQI,
+  WEATHER_FIELD_HOUR_TIME,  // Hourly and daily fields carry the entry's index
+  WEATHER_FIELD_HOUR_TEMP,
+  WEATHER_FIELD_HOUR_POP,
+  WEATHER_FIELD_HOUR_CONDITION,
+  WEATHER_FIELD_DAY_TIME,
+  WEATHER_FIELD_DAY_TEMP_MIN,
+  WEATHER_FIELD_DAY_TEMP_MAX,
+  WEATHER_FIELD_DAY_POP,
+  WEATHER_FIELD_DAY_CONDITION,
+  WEATHER_FIELD_SECTION_END,  // value is the weather_section_t that just completed
+} weather_field_id_t;
+
+// Values are in snapshot units: tenths of a degree, percent, weather_condition_t, unix seconds
+typedef struct __attribute__((packed)) {
+  uint8_t id;  // weather_field_id_t
+  uint16_t index;
+  int32_t value;
+} weather_field_t;
+
+weather_condition_t weatherConditionFromCode(int code);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "jsonParser.h"
+#include "weather.h"
+
+// Pulls the whitelisted fields of a One Call style forecast straight into a snapshot as the body
+// streams in. The document itself is never held in memory.
+// Called as each section of the snapshot is complete, so it can be used before the rest of the
+// body arrives
+typedef void (*weather_section_cb_t)(void *ctx, const weather_snapshot_t *snap,
+                                     weather_section_t section);
+
+// Called with every field as it's parsed, and when each section completes
+typedef void (*weather_field_cb_t)(void *ctx, const weather_field_t *field);
+
+typedef struct {
+  json_parser_t json;
+  weather_snapshot_t *out;  // NULL when streaming fields instead
+  bool air;          // Parsing an air pollution response
+  bool found;        // Saw what the document is for: current.dt, or the air quality index
+  weather_section_cb_t onSection;
+  weather_field_cb_t onField;
+  void *ctx;
+} weather_parser_t;
+
+// onSection may be NULL
+void weatherParserInit(weather_parser_t *parser, weather_snapshot_t *out,
+                       weather_section_cb_t onSection, void *ctx);
+
+// Same for an air pollution response, into a snapshot the forecast is (or will be) parsed into.
+// Only sets aqi, out isn't cleared.
+void weatherAirParserInit(weather_parser_t *parser, weather_snapshot_t *out,
+                          weather_section_cb_t onSection, void *ctx);
+
+// No snapshot at all: every field goes to onField as soon as it's parsed, so memory doesn't
+// grow with the document (forecast, or air pollution if air)
+void weatherFieldParserInit(weather_parser_t *parser, bool air, weather_field_cb_t onField,
+                            void *ctx);
+
+void weatherParserFeed(weather_parser_t *parser, const uint8_t *data, size_t len);
+
+// True if the whole document parsed and had its data in it (current conditions, or the index)
+bool weatherParserFinish(weather_parser_t *parser);
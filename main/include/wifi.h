@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdbool.h>
+
+typedef enum {
+  WIFI_STATE_IDLE,
+  WIFI_STATE_CONNECTING,  // esp_wifi_connect() issued, waiting on the AP
+  WIFI_STATE_BACKOFF,     // last attempt failed, retry timer running
+  WIFI_STATE_ASSOCIATED,  // associated, waiting on an IP
+  WIFI_STATE_CONNECTED,   // got an IP
+  WIFI_STATE_FAILED,      // out of retries or past the deadline, don't try again this wake
+} wifi_state_t;
+
+// Bring up the station interface and start connecting, returns immediately
+void wifiStart(void);
+
+// Block until the connection attempt started by wifiStart() succeeds or gives up. The overall
+// deadline starts counting at wifiStart(), so work done in between overlaps with association.
+bool wifiWaitConnected(void);
+
+wifi_state_t wifiGetState(void);
+
+// Forget the cached AP/lease so the next wake does a full scan and DHCP
+void wifiInvalidateCache(void);
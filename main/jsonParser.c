@@ -0,0 +1,304 @@
+#include "jsonParser.h"
+
+#include <string.h>
+
+enum {
+  ST_VALUE,       // Expecting a value
+  ST_KEY,         // Expecting a member name or '}'
+  ST_COLON,       // Expecting ':' after a member name
+  ST_AFTER,       // Expecting ',' or the end of the container
+  ST_STRING,
+  ST_STRING_ESC,  // Just saw a backslash
+  ST_SCALAR,      // Inside a number/true/false/null
+  ST_DONE,
+};
+
+void jsonParserInit(json_parser_t *parser, const char *const *keys, uint8_t keyCount,
+                    json_callback_t cb, void *ctx)
+{
+  memset(parser, 0, sizeof(*parser));
+  parser->keys = keys;
+  parser->keyCount = keyCount;
+  parser->cb = cb;
+  parser->ctx = ctx;
+  parser->state = ST_VALUE;
+}
+
+static void emit(json_parser_t *parser, json_event_t event)
+{
+  if (parser->cb) {
+    parser->cb(parser->ctx, parser, event, parser->tok, parser->tokLen);
+  }
+}
+
+static void tokPush(json_parser_t *parser, char c)
+{
+  if (parser->tokLen < CONFIG_JSON_TOKEN_MAX) {
+    parser->tok[parser->tokLen++] = c;
+  } else {
+    parser->tokOverflow = true;
+  }
+}
+
+static void tokReset(json_parser_t *parser)
+{
+  parser->tokLen = 0;
+  parser->tokOverflow = false;
+}
+
+static uint8_t lookupKey(const json_parser_t *parser)
+{
+  if (parser->tokOverflow) {
+    return JSON_KEY_OTHER;
+  }
+  for (uint8_t i = 0; i < parser->keyCount; i++) {
+    const char *k = parser->keys[i];
+    if (strncmp(k, parser->tok, parser->tokLen) == 0 && k[parser->tokLen] == '\0') {
+      return i + 1;
+    }
+  }
+  return JSON_KEY_OTHER;
+}
+
+// A value just finished, figure out what comes next
+static void valueDone(json_parser_t *parser)
+{
+  parser->state = parser->depth ? ST_AFTER : ST_DONE;
+}
+
+static bool push(json_parser_t *parser, bool isArray)
+{
+  if (parser->depth == CONFIG_JSON_MAX_DEPTH) {
+    return false;
+  }
+  tokReset(parser);
+  emit(parser, isArray ? JSON_ARRAY_BEGIN : JSON_OBJECT_BEGIN);
+  parser->stack[parser->depth++] = (json_frame_t){.isArray = isArray};
+  parser->state = isArray ? ST_VALUE : ST_KEY;
+  return true;
+}
+
+static bool pop(json_parser_t *parser, bool isArray)
+{
+  if (parser->depth == 0 || parser->stack[parser->depth - 1].isArray != isArray) {
+    return false;
+  }
+  parser->depth--;
+  tokReset(parser);
+  emit(parser, isArray ? JSON_ARRAY_END : JSON_OBJECT_END);
+  valueDone(parser);
+  return true;
+}
+
+static bool scalarDone(json_parser_t *parser)
+{
+  json_event_t event;
+  char c = parser->tokLen ? parser->tok[0] : 0;
+  if (c == 't' || c == 'f') {
+    event = JSON_BOOL;
+  } else if (c == 'n') {
+    event = JSON_NULL;
+  } else if (c == '-' || (c >= '0' && c <= '9')) {
+    event = JSON_NUMBER;
+  } else {
+    return false;
+  }
+  emit(parser, event);
+  valueDone(parser);
+  return true;
+}
+
+static bool isSpace(uint8_t c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Handle one character, returns false on a syntax error. Sets *again when c terminated a scalar
+// and has to be looked at again in the new state.
+static bool step(json_parser_t *parser, uint8_t c, bool *again)
+{
+  switch (parser->state) {
+    case ST_STRING:
+      if (c == '"') {
+        if (parser->isKey) {
+          parser->stack[parser->depth - 1].key = lookupKey(parser);
+          parser->state = ST_COLON;
+        } else {
+          emit(parser, JSON_STRING);
+          valueDone(parser);
+        }
+      } else if (c == '\\') {
+        parser->state = ST_STRING_ESC;
+      } else if (parser->escLeft) {
+        // Skipping the hex digits of a \u escape
+        if (--parser->escLeft == 0) {
+          tokPush(parser, '?');
+        }
+      } else {
+        tokPush(parser, (char)c);
+      }
+      return true;
+
+    case ST_STRING_ESC:
+      parser->state = ST_STRING;
+      switch (c) {
+        case 'n':
+          tokPush(parser, '\n');
+          break;
+        case 't':
+          tokPush(parser, '\t');
+          break;
+        case 'r':
+        case 'b':
+        case 'f':
+          break;
+        case 'u':
+          // We only ever render ASCII, non-ASCII code points become '?'
+          parser->escLeft = 4;
+          break;
+        default:
+          tokPush(parser, (char)c);
+          break;
+      }
+      return true;
+
+    case ST_SCALAR:
+      if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' ||
+          c == 'E') {
+        tokPush(parser, (char)c);
+        return true;
+      }
+      *again = true;
+      return scalarDone(parser);
+
+    default:
+      break;
+  }
+
+  if (isSpace(c)) {
+    return true;
+  }
+
+  switch (parser->state) {
+    case ST_VALUE:
+      if (c == '{') {
+        return push(parser, false);
+      } else if (c == '[') {
+        return push(parser, true);
+      } else if (c == ']') {
+        // Empty array
+        return parser->depth && parser->stack[parser->depth - 1].isArray &&
+               parser->stack[parser->depth - 1].index == 0 && pop(parser, true);
+      } else if (c == '"') {
+        tokReset(parser);
+        parser->isKey = false;
+        parser->state = ST_STRING;
+        return true;
+      }
+      tokReset(parser);
+      tokPush(parser, (char)c);
+      parser->state = ST_SCALAR;
+      return true;
+
+    case ST_KEY:
+      if (c == '"') {
+        tokReset(parser);
+        parser->isKey = true;
+        parser->state = ST_STRING;
+        return true;
+      }
+      return c == '}' && pop(parser, false);
+
+    case ST_COLON:
+      if (c != ':') {
+        return false;
+      }
+      parser->state = ST_VALUE;
+      return true;
+
+    case ST_AFTER:
+      json_frame_t *top = &parser->stack[parser->depth - 1];
+      if (c == ',') {
+        if (top->isArray) {
+          top->index++;
+          parser->state = ST_VALUE;
+        } else {
+          top->key = JSON_KEY_OTHER;
+          parser->state = ST_KEY;
+        }
+        return true;
+      }
+      return pop(parser, c == ']');
+
+    default:
+      // Trailing garbage after the document
+      return false;
+  }
+}
+
+bool jsonParserFeed(json_parser_t *parser, const uint8_t *data, size_t len)
+{
+  if (parser->failed) {
+    return false;
+  }
+
+  for (size_t i = 0; i < len; i++) {
+    bool again = false;
+    if (!step(parser, data[i], &again) || (again && !step(parser, data[i], &again))) {
+      parser->failed = true;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool jsonParserFinish(json_parser_t *parser)
+{
+  // A bare top level number has no terminator of its own
+  if (parser->state == ST_SCALAR && parser->depth == 0 && !scalarDone(parser)) {
+    parser->failed = true;
+  }
+  return !parser->failed && parser->state == ST_DONE;
+}
+
+int32_t jsonToFixed(const char *text, size_t len, uint8_t decimals)
+{
+  size_t i = 0;
+  bool neg = false;
+  if (i < len && (text[i] == '-' || text[i] == '+')) {
+    neg = text[i++] == '-';
+  }
+
+  int64_t value = 0;
+  for (; i < len && text[i] >= '0' && text[i] <= '9'; i++) {
+    value = value * 10 + (text[i] - '0');
+  }
+
+  // Keep `decimals` fractional digits, rounding on the next one
+  uint8_t frac = 0;
+  bool roundUp = false;
+  if (i < len && text[i] == '.') {
+    for (i++; i < len && text[i] >= '0' && text[i] <= '9'; i++) {
+      if (frac < decimals) {
+        value = value * 10 + (text[i] - '0');
+        frac++;
+      } else if (frac == decimals) {
+        roundUp = text[i] >= '5';
+        frac++;
+      }
+    }
+  }
+  for (; frac < decimals; frac++) {
+    value *= 10;
+  }
+  value += roundUp;
+
+  // Exponents don't show up in the fields we read, treat them as out of range
+  if (i < len && (text[i] == 'e' || text[i] == 'E')) {
+    return 0;
+  }
+  if (value > INT32_MAX) {
+    value = INT32_MAX;
+  }
+  return neg ? (int32_t)-value : (int32_t)value;
+}
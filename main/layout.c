@@ -0,0 +1,619 @@
+#include "layout.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "atlas.h"
+#include "hash.h"
+#include "text.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#else
+#define RTC_DATA_ATTR
+#endif
+
+#define LAYOUT_MAGIC 0x4C595431  // "LYT1"
+#define LAYOUT_MAX_CELLS 8
+#define LAYOUT_MAX_SLOTS 5
+
+// Hourly strip shows every third hour
+#define HOURLY_CELLS 8
+#define HOURLY_STEP 3
+#define DAILY_ROWS (WEATHER_DAILY_MAX < 7 ? WEATHER_DAILY_MAX : 7)
+
+typedef enum {
+  FONT_ID_SMALL,
+  FONT_ID_MEDIUM,
+  FONT_ID_LARGE,
+} font_id_t;
+
+typedef enum {
+  WIDGET_CURRENT,
+  WIDGET_TIMESTAMP,
+  WIDGET_DAILY,
+  WIDGET_HOURLY,
+  WIDGET_COUNT,
+} widget_id_t;
+
+typedef enum {
+  ALIGN_LEFT,
+  ALIGN_CENTER,
+  ALIGN_RIGHT,
+} align_t;
+
+// What a widget looks like: where it goes and how its area splits into cells (hours, days)
+typedef struct {
+  fb_rect_t rect;  // Byte aligned, so it can be a partial refresh window as is
+  uint8_t cells;
+  bool vertical;   // Cells stacked rather than side by side
+  align_t align;
+  uint8_t sections;  // Parts of the snapshot it shows
+  uint8_t fonts[LAYOUT_MAX_SLOTS];
+} widget_def_t;
+
+static const widget_def_t widgetDefs[WIDGET_COUNT] = {
+    [WIDGET_CURRENT] =
+        {
+            .rect = {0, 0, 400, 288},
+            .cells = 1,
+            .sections = WEATHER_SECTION_CURRENT | WEATHER_SECTION_AIR,
+            .fonts = {0, FONT_ID_LARGE, FONT_ID_MEDIUM, FONT_ID_MEDIUM, FONT_ID_MEDIUM},
+        },
+    [WIDGET_TIMESTAMP] =
+        {
+            .rect = {400, 0, 400, 40},
+            .cells = 1,
+            .align = ALIGN_RIGHT,
+            .sections = WEATHER_SECTION_CURRENT,
+            .fonts = {FONT_ID_SMALL},
+        },
+    [WIDGET_DAILY] =
+        {
+            .rect = {400, 48, 400, DAILY_ROWS * 34},
+            .cells = DAILY_ROWS,
+            .vertical = true,
+            .sections = WEATHER_SECTION_DAILY,
+            .fonts = {FONT_ID_SMALL, 0, FONT_ID_SMALL, FONT_ID_SMALL},
+        },
+    [WIDGET_HOURLY] =
+        {
+            .rect = {0, 296, 800, 184},
+            .cells = HOURLY_CELLS,
+            .align = ALIGN_CENTER,
+            .sections = WEATHER_SECTION_HOURLY,
+            .fonts = {FONT_ID_SMALL, 0, FONT_ID_MEDIUM, FONT_ID_SMALL},
+        },
+};
+
+static const font_t *const fonts[] = {
+    [FONT_ID_SMALL] = &fontSmall,
+    [FONT_ID_MEDIUM] = &fontMedium,
+    [FONT_ID_LARGE] = &fontLarge,
+};
+
+typedef struct {
+  int16_t x;
+  int16_t y;
+} point_t;
+
+// A widget resolved to absolute positions: icon top left corners and text anchors on baselines
+typedef struct {
+  fb_rect_t clip;
+  uint8_t cellCount;
+  uint8_t align;
+  uint8_t sections;
+  uint8_t fonts[LAYOUT_MAX_SLOTS];
+  point_t slots[LAYOUT_MAX_CELLS][LAYOUT_MAX_SLOTS];
+} widget_plan_t;
+
+// The plan only depends on the layout and the fonts, so it's worked out once per cold boot and
+// kept in RTC memory with the hashes of what each widget last put on the panel
+typedef struct {
+  uint32_t magic;
+  widget_plan_t widgets[WIDGET_COUNT];
+  uint32_t shown[WIDGET_COUNT];
+  bool shownValid[WIDGET_COUNT];
+} render_plan_t;
+
+RTC_DATA_ATTR static render_plan_t plan;
+
+// What the current conditions and timestamp widgets show
+typedef struct {
+  uint32_t time;
+  int32_t tzOffset;
+  int16_t temp;
+  int16_t feelsLike;
+  uint8_t humidity;
+  uint8_t condition;
+  uint8_t aqi;
+} now_t;
+
+// What fb holds for each widget this frame
+static uint32_t drawn[WIDGET_COUNT];
+static bool drawnValid[WIDGET_COUNT];
+static bool startedCurrent;  // fb started out as the committed frame
+
+// Streaming: what's been seen of the current conditions, and the one hour and day being filled in
+typedef struct {
+  now_t now;
+  int32_t hourIndex;  // -1 before the first
+  uint32_t hourTime;
+  weather_hour_t hour;
+  int32_t dayIndex;
+  uint32_t dayTime;
+  weather_day_t day;
+  uint32_t hash[WIDGET_COUNT];  // Of the cells drawn so far
+  bool open[WIDGET_COUNT];      // Cleared and partly drawn
+} stream_t;
+
+static stream_t stream;
+
+static const char *const airQuality[] = {"", "good", "fair", "moderate", "poor", "very poor"};
+
+static const char *const weekdays[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+
+// Shown values are whole degrees, so that's what the hashes see too
+static int16_t roundTemp(int16_t tenths)
+{
+  return (tenths + (tenths < 0 ? -5 : 5)) / 10;
+}
+
+static void localTime(uint32_t utc, int32_t tzOffset, struct tm *tm)
+{
+  time_t t = (time_t)utc + tzOffset;
+  gmtime_r(&t, tm);
+}
+
+static int16_t baselineBelow(int top, font_id_t font)
+{
+  return top + fonts[font]->ascent;
+}
+
+// Vertically centre a line of text in a band
+static int16_t baselineCentered(int top, int height, font_id_t font)
+{
+  return top + (height + fonts[font]->ascent) / 2;
+}
+
+static void resolveCell(widget_id_t id, const fb_rect_t *cell, point_t *slots)
+{
+  const uint8_t *f = widgetDefs[id].fonts;
+  int cx = cell->x + cell->w / 2;
+
+  switch (id) {
+    case WIDGET_CURRENT:
+      // Big icon with the temperature beside it, details underneath
+      slots[0] = (point_t){cell->x + 24, cell->y + 40};
+      slots[1] = (point_t){cell->x + 112, baselineCentered(cell->y + 40, 64, f[1])};
+      slots[2] = (point_t){cell->x + 24, baselineBelow(cell->y + 140, f[2])};
+      slots[3] = (point_t){cell->x + 24,
+                           baselineBelow(cell->y + 140 + fonts[f[2]]->lineHeight + 8, f[3])};
+      int airTop = cell->y + 140 + fonts[f[2]]->lineHeight + fonts[f[3]]->lineHeight + 16;
+      slots[4] = (point_t){cell->x + 24, baselineBelow(airTop, f[4])};
+      break;
+    case WIDGET_TIMESTAMP:
+      slots[0] = (point_t){cell->x + cell->w - 16, baselineCentered(cell->y, cell->h, f[0])};
+      break;
+    case WIDGET_DAILY:
+      // Day, icon, high/low, precipitation across the row
+      slots[0] = (point_t){cell->x + 16, baselineCentered(cell->y, cell->h, f[0])};
+      slots[1] = (point_t){cell->x + 88, cell->y + (cell->h - 32) / 2};
+      slots[2] = (point_t){cell->x + 144, baselineCentered(cell->y, cell->h, f[2])};
+      slots[3] = (point_t){cell->x + 304, baselineCentered(cell->y, cell->h, f[3])};
+      break;
+    case WIDGET_HOURLY:
+      // Hour, icon, temperature, precipitation down the cell
+      slots[0] = (point_t){cx, baselineBelow(cell->y + 16, f[0])};
+      slots[1] = (point_t){cx - 16, cell->y + 52};
+      slots[2] = (point_t){cx, baselineBelow(cell->y + 100, f[2])};
+      slots[3] = (point_t){cx, baselineBelow(cell->y + 140, f[3])};
+      break;
+    default:
+      break;
+  }
+}
+
+static void resolve(void)
+{
+  for (int id = 0; id < WIDGET_COUNT; id++) {
+    const widget_def_t *def = &widgetDefs[id];
+    widget_plan_t *wp = &plan.widgets[id];
+
+    wp->clip = def->rect;
+    wp->cellCount = def->cells;
+    wp->align = def->align;
+    wp->sections = def->sections;
+    memcpy(wp->fonts, def->fonts, sizeof(wp->fonts));
+
+    for (int c = 0; c < def->cells; c++) {
+      fb_rect_t cell = def->rect;
+      if (def->vertical) {
+        cell.h /= def->cells;
+        cell.y += c * cell.h;
+      } else {
+        cell.w /= def->cells;
+        cell.x += c * cell.w;
+      }
+      resolveCell(id, &cell, wp->slots[c]);
+    }
+  }
+
+  memset(plan.shownValid, 0, sizeof(plan.shownValid));
+  plan.magic = LAYOUT_MAGIC;
+}
+
+static void drawText(framebuffer_t *fb, const widget_plan_t *wp, int cell, int slot,
+                     const char *text)
+{
+  const font_t *font = fonts[wp->fonts[slot]];
+  point_t at = wp->slots[cell][slot];
+  if (wp->align == ALIGN_CENTER) {
+    at.x -= textWidth(font, text) / 2;
+  } else if (wp->align == ALIGN_RIGHT) {
+    at.x -= textWidth(font, text);
+  }
+  textDraw(fb, font, at.x, at.y, text, FB_BLACK);
+}
+
+static void drawIcon(framebuffer_t *fb, const widget_plan_t *wp, int cell, int slot,
+                     const bitmap_t *icons, uint8_t condition)
+{
+  condition = condition < WEATHER_COND_COUNT ? condition : WEATHER_COND_UNKNOWN;
+  fbBlit(fb, &icons[condition], wp->slots[cell][slot].x, wp->slots[cell][slot].y, FB_BLACK);
+}
+
+static now_t nowOf(const weather_snapshot_t *s)
+{
+  return (now_t){s->time, s->tzOffset, s->temp, s->feelsLike, s->humidity, s->condition, s->aqi};
+}
+
+// Each widget hashes exactly what it draws, and draws when fb is non-NULL. Cells are separate so
+// the streaming path can draw them one at a time.
+
+static uint32_t drawCurrent(framebuffer_t *fb, const widget_plan_t *wp, const now_t *n)
+{
+  const int16_t v[] = {n->condition, roundTemp(n->temp), roundTemp(n->feelsLike), n->humidity,
+                       n->aqi};
+  if (fb) {
+    char text[24];
+    drawIcon(fb, wp, 0, 0, iconsLarge, n->condition);
+    snprintf(text, sizeof(text), "%d" ATLAS_DEGREE, v[1]);
+    drawText(fb, wp, 0, 1, text);
+    snprintf(text, sizeof(text), "Feels like %d" ATLAS_DEGREE, v[2]);
+    drawText(fb, wp, 0, 2, text);
+    snprintf(text, sizeof(text), "Humidity %d%%", v[3]);
+    drawText(fb, wp, 0, 3, text);
+    if (n->aqi) {
+      snprintf(text, sizeof(text), "Air %s", airQuality[n->aqi]);
+      drawText(fb, wp, 0, 4, text);
+    }
+  }
+  return fnv1a(FNV1A_INIT, v, sizeof(v));
+}
+
+static uint32_t drawTimestamp(framebuffer_t *fb, const widget_plan_t *wp, const now_t *n)
+{
+  struct tm tm;
+  localTime(n->time, n->tzOffset, &tm);
+  const int v[] = {tm.tm_wday, tm.tm_hour, tm.tm_min};
+  if (fb) {
+    char text[24];
+    snprintf(text, sizeof(text), "Updated %s %02d:%02d", weekdays[v[0]], v[1], v[2]);
+    drawText(fb, wp, 0, 0, text);
+  }
+  return fnv1a(FNV1A_INIT, v, sizeof(v));
+}
+
+// One day's row at cell i, time being that day's
+static uint32_t dayCell(framebuffer_t *fb, const widget_plan_t *wp, uint32_t hash, int i,
+                        uint32_t time, int32_t tzOffset, const weather_day_t *d)
+{
+  struct tm tm;
+  localTime(time, tzOffset, &tm);
+  const int16_t v[] = {tm.tm_wday, d->condition, roundTemp(d->tempMax), roundTemp(d->tempMin),
+                       d->pop};
+  if (fb) {
+    char text[24];
+    drawText(fb, wp, i, 0, i == 0 ? "Today" : weekdays[v[0]]);
+    drawIcon(fb, wp, i, 1, iconsSmall, d->condition);
+    snprintf(text, sizeof(text), "%d" ATLAS_DEGREE " / %d" ATLAS_DEGREE, v[2], v[3]);
+    drawText(fb, wp, i, 2, text);
+    snprintf(text, sizeof(text), "%d%%", v[4]);
+    drawText(fb, wp, i, 3, text);
+  }
+  return fnv1a(hash, v, sizeof(v));
+}
+
+static uint32_t hourCell(framebuffer_t *fb, const widget_plan_t *wp, uint32_t hash, int i,
+                         uint32_t time, int32_t tzOffset, const weather_hour_t *h)
+{
+  struct tm tm;
+  localTime(time, tzOffset, &tm);
+  const int16_t v[] = {tm.tm_hour, h->condition, roundTemp(h->temp), h->pop};
+  if (fb) {
+    char text[16];
+    snprintf(text, sizeof(text), "%02d:00", v[0]);
+    drawText(fb, wp, i, 0, text);
+    drawIcon(fb, wp, i, 1, iconsSmall, h->condition);
+    snprintf(text, sizeof(text), "%d" ATLAS_DEGREE, v[2]);
+    drawText(fb, wp, i, 2, text);
+    snprintf(text, sizeof(text), "%d%%", v[3]);
+    drawText(fb, wp, i, 3, text);
+  }
+  return fnv1a(hash, v, sizeof(v));
+}
+
+static uint32_t current(framebuffer_t *fb, const widget_plan_t *wp, const weather_snapshot_t *s)
+{
+  const now_t n = nowOf(s);
+  return drawCurrent(fb, wp, &n);
+}
+
+static uint32_t timestamp(framebuffer_t *fb, const widget_plan_t *wp, const weather_snapshot_t *s)
+{
+  const now_t n = nowOf(s);
+  return drawTimestamp(fb, wp, &n);
+}
+
+static uint32_t daily(framebuffer_t *fb, const widget_plan_t *wp, const weather_snapshot_t *s)
+{
+  uint32_t hash = FNV1A_INIT;
+  for (int i = 0; i < wp->cellCount && i < s->dailyCount; i++) {
+    hash = dayCell(fb, wp, hash, i, s->dailyStart + i * 86400u, s->tzOffset, &s->daily[i]);
+  }
+  return hash;
+}
+
+static uint32_t hourly(framebuffer_t *fb, const widget_plan_t *wp, const weather_snapshot_t *s)
+{
+  uint32_t hash = FNV1A_INIT;
+  for (int i = 0; i < wp->cellCount && i * HOURLY_STEP < s->hourlyCount; i++) {
+    hash = hourCell(fb, wp, hash, i, s->hourlyStart + i * HOURLY_STEP * 3600u, s->tzOffset,
+                    &s->hourly[i * HOURLY_STEP]);
+  }
+  return hash;
+}
+
+typedef uint32_t (*widget_fn_t)(framebuffer_t *fb, const widget_plan_t *wp,
+                                const weather_snapshot_t *s);
+
+static const widget_fn_t widgetFns[WIDGET_COUNT] = {
+    [WIDGET_CURRENT] = current,
+    [WIDGET_TIMESTAMP] = timestamp,
+    [WIDGET_DAILY] = daily,
+    [WIDGET_HOURLY] = hourly,
+};
+
+static void unionRect(fb_rect_t *acc, const fb_rect_t *r)
+{
+  int x0 = acc->x < r->x ? acc->x : r->x;
+  int y0 = acc->y < r->y ? acc->y : r->y;
+  int x1 = acc->x + acc->w > r->x + r->w ? acc->x + acc->w : r->x + r->w;
+  int y1 = acc->y + acc->h > r->y + r->h ? acc->y + acc->h : r->y + r->h;
+  *acc = (fb_rect_t){x0, y0, x1 - x0, y1 - y0};
+}
+
+static void widgetDrawn(widget_id_t id, uint32_t hash)
+{
+  drawn[id] = hash;
+  drawnValid[id] = true;
+}
+
+void layoutBegin(bool current)
+{
+  if (plan.magic != LAYOUT_MAGIC) {
+    resolve();
+    current = false;
+  }
+
+  memcpy(drawn, plan.shown, sizeof(drawn));
+  for (int id = 0; id < WIDGET_COUNT; id++) {
+    drawnValid[id] = current && plan.shownValid[id];
+  }
+  startedCurrent = current;
+
+  memset(&stream, 0, sizeof(stream));
+  stream.hourIndex = -1;
+  stream.dayIndex = -1;
+}
+
+void layoutRender(framebuffer_t *fb, const weather_snapshot_t *snap, uint32_t sections)
+{
+  for (int id = 0; id < WIDGET_COUNT; id++) {
+    const widget_plan_t *wp = &plan.widgets[id];
+    if (!(wp->sections & sections)) {
+      continue;
+    }
+
+    // Hash first, only pay for drawing what changed
+    uint32_t hash = widgetFns[id](NULL, wp, snap);
+    if (drawnValid[id] && hash == drawn[id]) {
+      continue;
+    }
+
+    fbFillRect(fb, wp->clip.x, wp->clip.y, wp->clip.w, wp->clip.h, FB_WHITE);
+    widgetFns[id](fb, wp, snap);
+    widgetDrawn(id, hash);
+  }
+}
+
+// Streaming draws before it knows whether anything changed. The same values give the same pixels,
+// so a widget that comes out with the hash it had is left out of the dirty area all the same.
+static void streamOpen(framebuffer_t *fb, widget_id_t id)
+{
+  if (!stream.open[id]) {
+    const fb_rect_t *clip = &plan.widgets[id].clip;
+    fbFillRect(fb, clip->x, clip->y, clip->w, clip->h, FB_WHITE);
+    stream.hash[id] = FNV1A_INIT;
+    stream.open[id] = true;
+  }
+}
+
+static void streamClose(framebuffer_t *fb, widget_id_t id)
+{
+  streamOpen(fb, id);  // A section with nothing in it still empties the widget
+  stream.open[id] = false;
+  widgetDrawn(id, stream.hash[id]);
+}
+
+// The hour or day being filled in is complete
+static void flushHour(framebuffer_t *fb)
+{
+  const widget_plan_t *wp = &plan.widgets[WIDGET_HOURLY];
+  int32_t i = stream.hourIndex;
+  if (i < 0 || i % HOURLY_STEP || i / HOURLY_STEP >= wp->cellCount) {
+    return;
+  }
+  streamOpen(fb, WIDGET_HOURLY);
+  stream.hash[WIDGET_HOURLY] = hourCell(fb, wp, stream.hash[WIDGET_HOURLY], i / HOURLY_STEP,
+                                        stream.hourTime, stream.now.tzOffset, &stream.hour);
+}
+
+static void flushDay(framebuffer_t *fb)
+{
+  const widget_plan_t *wp = &plan.widgets[WIDGET_DAILY];
+  int32_t i = stream.dayIndex;
+  if (i < 0 || i >= wp->cellCount) {
+    return;
+  }
+  streamOpen(fb, WIDGET_DAILY);
+  stream.hash[WIDGET_DAILY] = dayCell(fb, wp, stream.hash[WIDGET_DAILY], i, stream.dayTime,
+                                      stream.now.tzOffset, &stream.day);
+}
+
+static void streamNow(framebuffer_t *fb)
+{
+  streamOpen(fb, WIDGET_CURRENT);
+  stream.hash[WIDGET_CURRENT] = drawCurrent(fb, &plan.widgets[WIDGET_CURRENT], &stream.now);
+  streamClose(fb, WIDGET_CURRENT);
+}
+
+static void streamSection(framebuffer_t *fb, weather_section_t section)
+{
+  switch (section) {
+    case WEATHER_SECTION_CURRENT:
+      streamOpen(fb, WIDGET_TIMESTAMP);
+      stream.hash[WIDGET_TIMESTAMP] =
+          drawTimestamp(fb, &plan.widgets[WIDGET_TIMESTAMP], &stream.now);
+      streamClose(fb, WIDGET_TIMESTAMP);
+      streamNow(fb);
+      break;
+    case WEATHER_SECTION_AIR:
+      // Usually after the current conditions were drawn, this redraws them with the index
+      streamNow(fb);
+      break;
+    case WEATHER_SECTION_HOURLY:
+      flushHour(fb);
+      stream.hourIndex = -1;
+      streamClose(fb, WIDGET_HOURLY);
+      break;
+    case WEATHER_SECTION_DAILY:
+      flushDay(fb);
+      stream.dayIndex = -1;
+      streamClose(fb, WIDGET_DAILY);
+      break;
+    default:
+      break;
+  }
+}
+
+void layoutField(framebuffer_t *fb, const weather_field_t *f)
+{
+  now_t *now = &stream.now;
+  if (f->id >= WEATHER_FIELD_HOUR_TIME && f->id <= WEATHER_FIELD_HOUR_CONDITION &&
+      f->index != stream.hourIndex) {
+    flushHour(fb);
+    stream.hourIndex = f->index;
+    stream.hour = (weather_hour_t){0};
+  } else if (f->id >= WEATHER_FIELD_DAY_TIME && f->id <= WEATHER_FIELD_DAY_CONDITION &&
+             f->index != stream.dayIndex) {
+    flushDay(fb);
+    stream.dayIndex = f->index;
+    stream.day = (weather_day_t){0};
+  }
+
+  switch (f->id) {
+    case WEATHER_FIELD_TZ_OFFSET:
+      now->tzOffset = f->value;
+      break;
+    case WEATHER_FIELD_TIME:
+      now->time = f->value;
+      break;
+    case WEATHER_FIELD_TEMP:
+      now->temp = f->value;
+      break;
+    case WEATHER_FIELD_FEELS_LIKE:
+      now->feelsLike = f->value;
+      break;
+    case WEATHER_FIELD_HUMIDITY:
+      now->humidity = f->value;
+      break;
+    case WEATHER_FIELD_CONDITION:
+      now->condition = f->value;
+      break;
+    case WEATHER_FIELD_AQI:
+      now->aqi = f->value;
+      break;
+    case WEATHER_FIELD_HOUR_TIME:
+      stream.hourTime = f->value;
+      break;
+    case WEATHER_FIELD_HOUR_TEMP:
+      stream.hour.temp = f->value;
+      break;
+    case WEATHER_FIELD_HOUR_POP:
+      stream.hour.pop = f->value;
+      break;
+    case WEATHER_FIELD_HOUR_CONDITION:
+      stream.hour.condition = f->value;
+      break;
+    case WEATHER_FIELD_DAY_TIME:
+      stream.dayTime = f->value;
+      break;
+    case WEATHER_FIELD_DAY_TEMP_MIN:
+      stream.day.tempMin = f->value;
+      break;
+    case WEATHER_FIELD_DAY_TEMP_MAX:
+      stream.day.tempMax = f->value;
+      break;
+    case WEATHER_FIELD_DAY_POP:
+      stream.day.pop = f->value;
+      break;
+    case WEATHER_FIELD_DAY_CONDITION:
+      stream.day.condition = f->value;
+      break;
+    case WEATHER_FIELD_SECTION_END:
+      streamSection(fb, f->value);
+      break;
+    default:
+      break;
+  }
+}
+
+bool layoutDirty(fb_rect_t *dirty)
+{
+  // Worked out at the end, so a widget that changed and then changed back (or that streaming
+  // redrew as it was) isn't refreshed for nothing
+  bool any = false;
+  for (int id = 0; id < WIDGET_COUNT; id++) {
+    if (!drawnValid[id] ||
+        (startedCurrent && plan.shownValid[id] && drawn[id] == plan.shown[id])) {
+      continue;
+    }
+    if (any) {
+      unionRect(dirty, &plan.widgets[id].clip);
+    } else {
+      *dirty = plan.widgets[id].clip;
+      any = true;
+    }
+  }
+  return any;
+}
+
+void layoutCommit(void)
+{
+  // Widgets that never got drawn onto a blank frame aren't on the panel either
+  memcpy(plan.shown, drawn, sizeof(plan.shown));
+  memcpy(plan.shownValid, drawnValid, sizeof(plan.shownValid));
+}
@@ -1,234 +1,299 @@
 #include <stdio.h>
 
+#include "arena.h"
+#include "battery.h"
+#include "cycle.h"
+#include "esp_attr.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
-#include "freertos/event_groups.h"
-#include "lwip/netdb.h"
-#include "lwip/sockets.h"
-#include "nvs_flash.h"
+#include "forecastCache.h"
+#include "hash.h"
+#include "http.h"
+#include "hub.h"
+#include "node.h"
+#include "probe.h"
+#include "render.h"
+#include "schedule.h"
 #include "sdkconfig.h"
+#include "telemetry.h"
+#include "weatherJson.h"
+#include "wifi.h"
+
+#if !CONFIG_RENDER_STREAMING
+// Latest parsed forecast, what the display is rendered from
+static weather_snapshot_t snapshot;
+// The one on the panel, for a button wake to redraw without fetching. Good while its hash is
+// rtcState.snapshotHash.
+RTC_DATA_ATTR static weather_snapshot_t shown;
+#endif
+
+#if !CONFIG_DEVICE_ROLE_NODE
+// What's fetched each wake, air quality only when it's shown
+enum {
+  FETCH_FORECAST,
+  FETCH_AIR,
+#if CONFIG_WEATHER_AIR_QUALITY
+  FETCH_COUNT = 2,
+#else
+  FETCH_COUNT = 1,
+#endif
+};
+
+// Context for the body consumer of a single fetch
+typedef struct {
+  int status;
+  weather_parser_t parser;
+} fetch_ctx_t;
+
+static void onStatus(void *ctx, int status)
+{
+  ((fetch_ctx_t *)ctx)->status = status;
+}
 
-#define WIFI_SSID CONFIG_ESP_WIFI_SSID
-#define WIFI_PASS CONFIG_ESP_WIFI_PASS
-#define WIFI_RETRY CONFIG_ESP_MAXIMUM_RETRY
-
-#define WEATHER_API_KEY CONFIG_ESP_WEATHER_KEY
-#define WEATHER_API_URL "httpbin.org"
-
-// Event group for communucating when Wi-Fi is connected
-static EventGroupHandle_t wifiEventGroup;
-#define WIFI_CONN_SUCC BIT0
-#define WIFI_CONN_FAIL BIT1
-
-static int connRetries = 0;
-
-static const char *REQUEST =
-    "GET "
-    "/"
-    " HTTP/1.0\r\n"
-    "Host: " WEATHER_API_URL
-    ":"
-    "80"
-    "\r\n"
-    "User-Agent: esp-idf/1.0 esp32\r\n"
-    "\r\n";
-
-static void wifiEventHandler(void *arg, esp_event_base_t event_base, int32_t event_id,
-                             void *event_data)
+// The forecast's Date and cache headers plan the next wake
+static void onHeader(void *ctx, const char *name, const char *value)
 {
-  // Sanity check
-  if (event_base != WIFI_EVENT) {
-    return;
-  }
+  scheduleHeader(name, value);
+}
 
-  switch (event_id) {
-    case WIFI_EVENT_STA_START:
-      esp_wifi_connect();
-      break;
-
-    case WIFI_EVENT_STA_DISCONNECTED:
-      if (connRetries < WIFI_RETRY) {
-        esp_wifi_connect();
-        connRetries++;
-      } else {
-        xEventGroupSetBits(wifiEventGroup, WIFI_CONN_FAIL);
-      }
-      break;
+#if CONFIG_RENDER_STREAMING
+// No snapshot to hash, so the fields themselves are
+static uint32_t fieldHash = FNV1A_INIT;
+// And no snapshot to take the scheduler's timestamps from
+static uint32_t dataTime;
+static int32_t dataTzOffset;
 
-    default:
-      break;
+// Every field goes to the render task as it's parsed
+static void onField(void *ctx, const weather_field_t *field)
+{
+  fieldHash = fnv1a(fieldHash, field, sizeof(*field));
+  if (field->id == WEATHER_FIELD_TIME) {
+    dataTime = field->value;
+  } else if (field->id == WEATHER_FIELD_TZ_OFFSET) {
+    dataTzOffset = field->value;
   }
+  renderField(field);
 }
-
-static void ipEventHandler(void *arg, esp_event_base_t event_base, int32_t event_id,
-                           void *event_data)
+#else
+// Hand each part of the forecast to the render task as soon as it's parsed
+static void onSection(void *ctx, const weather_snapshot_t *snap, weather_section_t section)
 {
-  // Sanity check
-  if (event_base != IP_EVENT) {
-    return;
-  }
-
-  switch (event_id) {
-    case IP_EVENT_STA_GOT_IP:
-      ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
-      ESP_LOGI("WIFI", "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
-      connRetries = 0;
-      xEventGroupSetBits(wifiEventGroup, WIFI_CONN_SUCC);
-      break;
+  renderSection(snap, section);
+}
+#endif
 
-    default:
-      break;
-  }
+static void onBody(void *ctx, const uint8_t *data, size_t len)
+{
+  fetch_ctx_t *fetch = ctx;
+  probeBegin(PROBE_PARSE);
+  weatherParserFeed(&fetch->parser, data, len);
+  probeEnd(PROBE_PARSE);
 }
+#endif
 
-void connectWIFI(void)
+#if CONFIG_FORECAST_CACHE
+// Nothing usable came in: the kept forecast moved on to now stands in for it, so the panel keeps
+// up with the hours instead of waiting on the network
+static bool advanceKept(uint32_t *hash)
 {
-  /* Let's set up Wi-Fi */
-  wifiEventGroup = xEventGroupCreate();
-
-  // Call esp_netif_init() to create LwIP task (TCP/IP Stack)
-  ESP_ERROR_CHECK(esp_netif_init());
-
-  // Create default event loop (this is where we get WIFI and IP Events to handle)
-  ESP_ERROR_CHECK(esp_event_loop_create_default());
-
-  // Create default network interface to bind with TCP/IP stack
-  esp_netif_create_default_wifi_sta();
-
-  // Create and initialize Wi-Fi driver task with default config
-  wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-  ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-
-  /* Now we configure the newly created Wi-Fi driver */
-  // Handle any Wi-Fi Event (specifically looking for connect and disconnect events)
-  esp_event_handler_instance_t instance_any_id;
-  ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
-                                                      &wifiEventHandler, NULL, &instance_any_id));
-
-  // Handle station getting an IP address event
-  esp_event_handler_instance_t instance_got_ip;
-  ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
-                                                      &ipEventHandler, NULL, &instance_got_ip));
-
-  wifi_config_t wifiConfig = {
-      .sta =
-          {
-              .ssid = WIFI_SSID,
-              .password = WIFI_PASS,
-          },
-  };
-
-  // Set us to station (client) mode
-  ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-  // Load in our config settings
-  ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifiConfig));
-  // Start the Wi-Fi module
-  ESP_ERROR_CHECK(esp_wifi_start());
-
-  /* Now we just wait to connect or fail to connect */
-  EventBits_t bits = xEventGroupWaitBits(wifiEventGroup, WIFI_CONN_SUCC | WIFI_CONN_FAIL, pdFALSE,
-                                         pdFALSE, portMAX_DELAY);
-
-  // Check the EventBits to see what happened
-  if (bits & WIFI_CONN_SUCC) {
-    ESP_LOGI("WIFI", "connected to ap SSID:%s", WIFI_SSID);
-  } else if (bits & WIFI_CONN_FAIL) {
-    ESP_LOGI("WIFI", "Failed to connect to SSID:%s", WIFI_SSID);
-  } else {
-    ESP_LOGE("WIFI", "UNEXPECTED EVENT");
+  uint32_t now = scheduleNow();
+  if (!now || !forecastCacheLoad(now, &snapshot)) {
+    return false;
   }
+  *hash = fnv1a(FNV1A_INIT, &snapshot, sizeof(snapshot));
+  return true;
 }
+#endif
 
-void sendHTTPReq(void)
+#if CONFIG_WAKE_BUTTON && !CONFIG_RENDER_STREAMING
+// A button wake between refreshes: draw the forecast already on the panel afresh with a full
+// refresh, which clears the ghosting partial refreshes leave. No radio and no NVS.
+static void redraw(void)
 {
-  const struct addrinfo hints = {
-      .ai_family = AF_INET,
-      .ai_socktype = SOCK_STREAM,
-  };
-  struct addrinfo *res;
-  struct in_addr *addr;
-  int s, r;
-  char recv_buf[64];
-
-  // Get address struct setup (including DNS lookup)
-  int err = getaddrinfo(WEATHER_API_URL, "80", &hints, &res);
-
-  if (err != 0 || res == NULL) {
-    ESP_LOGE("HTTP", "DNS lookup failed err=%d res=%p", err, res);
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
-    return;
+  renderStart(true);
+  probeEnd(PROBE_INIT);
+  renderSection(&shown, WEATHER_SECTION_ALL);
+  if (renderFinish(true) == ESP_OK) {
+    ESP_LOGI("CYCLE", "redrawn from the kept forecast");
   }
+  probeFinish(rtcState.bootCount);
+  cycleResume();
+}
+#endif
 
-  addr = &((struct sockaddr_in *)res->ai_addr)->sin_addr;
-  ESP_LOGI("HTTP", "DNS lookup succeeded. IP=%s", inet_ntoa(*addr));
-
-  // Allocate a socket to ousrself
-  s = socket(res->ai_family, res->ai_socktype, 0);
-  if (s < 0) {
-    ESP_LOGE("HTTP", "Socket allocation failed");
-    freeaddrinfo(res);
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
-    return;
+void app_main(void)
+{
+  probeInit();
+  probeBegin(PROBE_INIT);
+
+  // What woke us decides how much of the system this wake needs
+  cycle_wake_t wake = cycleInit();
+
+#if CONFIG_DEVICE_ROLE_HUB
+  // Headless, fetches for the nodes instead of a panel of its own
+  cycleNvsInit();
+  hubRun();
+#endif
+
+#if CONFIG_WAKE_BUTTON && !CONFIG_RENDER_STREAMING
+  if (wake == CYCLE_WAKE_BUTTON && !cycleRefreshDue() && rtcState.snapshotHash &&
+      fnv1a(FNV1A_INIT, &shown, sizeof(shown)) == rtcState.snapshotHash) {
+    redraw();
   }
-  ESP_LOGI("HTTP", "Socket allocated");
-
-  if (connect(s, res->ai_addr, res->ai_addrlen) != 0) {
-    ESP_LOGE("HTTP", "Socket failed to connect");
-    close(s);
-    freeaddrinfo(res);
-    vTaskDelay(4000 / portTICK_PERIOD_MS);
-    return;
+#else
+  (void)wake;
+#endif
+
+  // Before the radio comes up and starts pulling the supply down
+  uint16_t batteryMv = batteryReadMv();
+  probeSetBattery(batteryMv);
+  scheduleSetBattery(batteryMv);
+
+  // wake -> fetch -> render -> sleep, with the display side (bring-up, restoring the last frame,
+  // drawing) on the other core so it overlaps with NVS, association, DHCP and the download
+  renderStart(false);
+  // The Wi-Fi driver keeps its PHY calibration in NVS
+  cycleNvsInit();
+
+  bool show = false;
+  uint32_t hash = 0;
+
+#if CONFIG_DEVICE_ROLE_NODE
+  // The hub did the fetching and parsing, all this wake needs is one frame from it
+  probeEnd(PROBE_INIT);
+  if (nodeReceive(&snapshot)) {
+    rtcState.fetchFailures = 0;
+    hash = fnv1a(FNV1A_INIT, &snapshot, sizeof(snapshot));
+    if (hash != rtcState.snapshotHash) {
+      renderSection(&snapshot, WEATHER_SECTION_ALL);
+      show = true;
+    }
+  } else if (rtcState.fetchFailures < UINT8_MAX) {
+    rtcState.fetchFailures++;
   }
+#else
+  wifiStart();
+  probeEnd(PROBE_INIT);
+  if (wifiWaitConnected()) {
+    rtcState.wifiFailures = 0;
+
+    // Parser state only lives for the fetch, so it comes out of the arena. Both responses parse
+    // into the same snapshot, the forecast first (which clears it).
+    fetch_ctx_t *fetch = arenaCalloc(FETCH_COUNT, sizeof(*fetch));
+    ESP_ERROR_CHECK(fetch ? ESP_OK : ESP_ERR_NO_MEM);
+#if CONFIG_RENDER_STREAMING
+    weatherFieldParserInit(&fetch[FETCH_FORECAST].parser, false, onField, NULL);
+#if CONFIG_WEATHER_AIR_QUALITY
+    weatherFieldParserInit(&fetch[FETCH_AIR].parser, true, onField, NULL);
+#endif
+#else
+    weatherParserInit(&fetch[FETCH_FORECAST].parser, &snapshot, onSection, NULL);
+#if CONFIG_WEATHER_AIR_QUALITY
+    weatherAirParserInit(&fetch[FETCH_AIR].parser, &snapshot, onSection, NULL);
+#endif
+#endif
+    http_fetch_t requests[FETCH_COUNT];
+    for (int i = 0; i < FETCH_COUNT; i++) {
+      requests[i] = (http_fetch_t){
+          .endpoint = i == FETCH_FORECAST ? HTTP_ENDPOINT_FORECAST : HTTP_ENDPOINT_AIR,
+          .cb = {.onStatus = onStatus,
+                 .onHeader = i == FETCH_FORECAST ? onHeader : NULL,
+                 .onBody = onBody,
+                 .ctx = &fetch[i]},
+      };
+    }
+    // Pipelined on one connection, the air quality costs no extra handshake
+    httpFetch(requests, FETCH_COUNT);
+
+    fetch_ctx_t *forecast = &fetch[FETCH_FORECAST];
+    esp_err_t err = requests[FETCH_FORECAST].result;
+    if (err == ESP_OK && forecast->status == 304) {
+      // Server says nothing changed, skip parsing and the panel refresh entirely
+      ESP_LOGI("CYCLE", "forecast not modified");
+      rtcState.fetchFailures = 0;
+      scheduleCommit();
+    } else if (err == ESP_OK && forecast->status == 200 &&
+               weatherParserFinish(&forecast->parser)) {
+      rtcState.fetchFailures = 0;
+      httpSaveValidators();
+      scheduleCommit();
+#if CONFIG_RENDER_STREAMING
+      scheduleSetData(dataTime, dataTzOffset);
+#else
+      scheduleSetData(snapshot.time, snapshot.tzOffset);
+#endif
+#if CONFIG_WEATHER_AIR_QUALITY
+      // The forecast is still worth showing without it
+      fetch_ctx_t *air = &fetch[FETCH_AIR];
+      if (requests[FETCH_AIR].result != ESP_OK || air->status != 200 ||
+          !weatherParserFinish(&air->parser)) {
+        ESP_LOGW("CYCLE", "no air quality this time");
+#if !CONFIG_RENDER_STREAMING
+        snapshot.aqi = 0;
+#endif
+      }
+#endif
+
+#if CONFIG_RENDER_STREAMING
+      // Everything was drawn as it arrived, only the decision to show it is left
+      hash = fieldHash;
+      show = hash != rtcState.snapshotHash;
+#else
+      // Changed validators don't always mean changed data
+      hash = fnv1a(FNV1A_INIT, &snapshot, sizeof(snapshot));
+      if (hash != rtcState.snapshotHash) {
+        // Anything that ended up out of order in the body gets drawn now
+        renderSection(&snapshot, WEATHER_SECTION_ALL);
+        show = true;
+#if CONFIG_FORECAST_CACHE
+        forecastCacheSave(&snapshot);
+#endif
+      }
+#endif
+    } else {
+      // A stale cached lease can associate fine and still be unusable. A bad status or body
+      // means the network worked though, so the next wake keeps its fast path.
+      if (err != ESP_OK) {
+        wifiInvalidateCache();
+      }
+      if (rtcState.fetchFailures < UINT8_MAX) {
+        rtcState.fetchFailures++;
+      }
+    }
+    arenaFree(fetch);
 
-  ESP_LOGI("HTTP", "Socket connected");
-  freeaddrinfo(res);
-
-  // Write HTTP GET request packet
-  if (write(s, REQUEST, strlen(REQUEST)) < 0) {
-    ESP_LOGE("HTTP", "Socket sending failure");
-    close(s);
-    vTaskDelay(4000 / portTICK_PERIOD_MS);
-    return;
-  }
-  ESP_LOGI("HTTP", "Socket sending success");
-
-  // Await response
-  struct timeval receiving_timeout;
-  receiving_timeout.tv_sec = 5;
-  receiving_timeout.tv_usec = 0;
-  if (setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &receiving_timeout, sizeof(receiving_timeout)) < 0) {
-    ESP_LOGE("HTTP", "Failed to set a timeout for socket receiving");
-    close(s);
-    vTaskDelay(4000 / portTICK_PERIOD_MS);
-    return;
+    // After the fetch so it never holds up the forecast, before the radio goes off
+    telemetrySend();
+    httpPoolClose();
+  } else if (rtcState.wifiFailures < UINT8_MAX) {
+    rtcState.wifiFailures++;
   }
-  ESP_LOGI("HTTP", "Successfully set socket timeout");
-
-  // Print response
-  do {
-    bzero(recv_buf, sizeof(recv_buf));
-    r = read(s, recv_buf, sizeof(recv_buf) - 1);
-    for (int i = 0; i < r; i++) {
-      putchar(recv_buf[i]);
-    }
-  } while (r > 0);
 
-  ESP_LOGI("HTTP", "... done reading from socket. Last read return=%d errno=%d.", r, errno);
-  close(s);
-  vTaskDelay(4000 / portTICK_PERIOD_MS);
-}
+  // The radio isn't needed for the panel refresh, shut it down first
+  esp_wifi_stop();
 
-void app_main(void)
-{
-  // Initialize NVS (Store Wi-Fi creds)
-  esp_err_t ret = nvs_flash_init();
-  if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-    ESP_ERROR_CHECK(nvs_flash_erase());
-    ret = nvs_flash_init();
+#if CONFIG_FORECAST_CACHE
+  rtcState.offline = (rtcState.wifiFailures || rtcState.fetchFailures) && advanceKept(&hash);
+  if (rtcState.offline && hash != rtcState.snapshotHash) {
+    ESP_LOGW("CYCLE", "offline, showing the kept forecast");
+    renderSection(&snapshot, WEATHER_SECTION_ALL);
+    show = true;
+  }
+#endif
+#endif
+
+  if (renderFinish(show) == ESP_OK && show) {
+    ESP_LOGI("CYCLE", "forecast changed, redrawn");
+    cycleSetSnapshotHash(hash);
+#if !CONFIG_RENDER_STREAMING
+    shown = snapshot;
+#endif
   }
-  ESP_ERROR_CHECK(ret);
 
-  connectWIFI();
-  sendHTTPReq();
+  ESP_LOGI("CYCLE", "arena peak %u of %u bytes", (unsigned)arenaHighWater(),
+           (unsigned)arenaCapacity());
+  arenaReset();
+  probeFinish(rtcState.bootCount);
+  cycleSleep();
 }
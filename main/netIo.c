@@ -0,0 +1,88 @@
+#include "netIo.h"
+
+#include <errno.h>
+
+#include "esp_timer.h"
+
+int64_t netDeadline(uint32_t ms)
+{
+  return esp_timer_get_time() + (int64_t)ms * 1000;
+}
+
+bool netWait(int fd, bool write, int64_t deadlineUs)
+{
+  for (;;) {
+    int64_t left = deadlineUs - esp_timer_get_time();
+    if (left <= 0) {
+      errno = ETIMEDOUT;
+      return false;
+    }
+    struct timeval tv = {
+        .tv_sec = left / 1000000,
+        .tv_usec = left % 1000000,
+    };
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    int ret = select(fd + 1, write ? NULL : &fds, write ? &fds : NULL, NULL, &tv);
+    if (ret > 0) {
+      return true;
+    }
+    if (ret < 0 && errno != EINTR) {
+      return false;
+    }
+  }
+}
+
+int netConnect(const struct sockaddr_in *dest, int64_t deadlineUs)
+{
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  if (s < 0) {
+    return -1;
+  }
+  fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+
+  if (connect(s, (const struct sockaddr *)dest, sizeof(*dest)) != 0) {
+    // In progress, done once the socket turns writable
+    int err = errno;
+    socklen_t len = sizeof(err);
+    if (err != EINPROGRESS || !netWait(s, true, deadlineUs) ||
+        getsockopt(s, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+      close(s);
+      return -1;
+    }
+  }
+  return s;
+}
+
+int netRead(int fd, void *buf, size_t len, int64_t deadlineUs)
+{
+  for (;;) {
+    int r = read(fd, buf, len);
+    if (r >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+      return r;
+    }
+    if (!netWait(fd, false, deadlineUs)) {
+      return -1;
+    }
+  }
+}
+
+int netWrite(int fd, const void *buf, size_t len, int64_t deadlineUs)
+{
+  const uint8_t *p = buf;
+  size_t done = 0;
+  while (done < len) {
+    int r = write(fd, p + done, len - done);
+    if (r > 0) {
+      done += r;
+    } else if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (!netWait(fd, true, deadlineUs)) {
+        return -1;
+      }
+    } else {
+      return -1;
+    }
+  }
+  return (int)done;
+}
@@ -0,0 +1,91 @@
+#include "node.h"
+
+#if CONFIG_DEVICE_ROLE_NODE
+
+#include <string.h>
+
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_now.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "probe.h"
+#include "snapshotCodec.h"
+
+// Filled in by the receive callback (Wi-Fi task), read once rxReady is set
+static uint8_t rxFrame[SNAPSHOT_FRAME_MAX];
+static size_t rxLen;
+static volatile bool rxReady;
+static SemaphoreHandle_t rxSem;
+
+// Just enough of a look to drop other locations' frames, the full check happens in nodeReceive
+static void onRecv(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+{
+  if (rxReady || len < SNAPSHOT_FRAME_HEADER || len > SNAPSHOT_FRAME_MAX ||
+      data[0] != SNAPSHOT_FRAME_MAGIC0 || data[1] != SNAPSHOT_FRAME_MAGIC1 ||
+      data[3] != CONFIG_NODE_LOCATION) {
+    return;
+  }
+  memcpy(rxFrame, data, len);
+  rxLen = len;
+  rxReady = true;
+  xSemaphoreGive(rxSem);
+}
+
+static void radioStart(void)
+{
+  ESP_ERROR_CHECK(esp_event_loop_create_default());
+  wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+  ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+  // Nothing worth persisting, and it saves flash writes every wake
+  ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+  ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+  ESP_ERROR_CHECK(esp_wifi_start());
+  // Straight onto the hub's channel, no scan and no association
+  ESP_ERROR_CHECK(esp_wifi_set_channel(CONFIG_NODE_CHANNEL, WIFI_SECOND_CHAN_NONE));
+  ESP_ERROR_CHECK(esp_now_init());
+  ESP_ERROR_CHECK(esp_now_register_recv_cb(onRecv));
+}
+
+static void radioStop(void)
+{
+  esp_now_deinit();
+  esp_wifi_stop();
+}
+
+bool nodeReceive(weather_snapshot_t *out)
+{
+  static StaticSemaphore_t rxSemStruct;
+  rxSem = xSemaphoreCreateBinaryStatic(&rxSemStruct);
+
+  probeBegin(PROBE_LISTEN);
+  int64_t startUs = esp_timer_get_time();
+  int64_t deadlineUs = startUs + (int64_t)CONFIG_NODE_LISTEN_MS * 1000;
+  radioStart();
+
+  bool got = false;
+  for (;;) {
+    int64_t leftUs = deadlineUs - esp_timer_get_time();
+    if (leftUs <= 0 || xSemaphoreTake(rxSem, pdMS_TO_TICKS(leftUs / 1000) + 1) != pdTRUE) {
+      break;
+    }
+    uint8_t location;
+    if (snapshotDecode(rxFrame, rxLen, &location, out)) {
+      got = true;
+      break;
+    }
+    // Not ours after all (corrupt, or a hub on a newer version), wait for the next one
+    ESP_LOGW("NODE", "dropped a %u byte frame", (unsigned)rxLen);
+    rxReady = false;
+  }
+
+  radioStop();
+  probeEnd(PROBE_LISTEN);
+  ESP_LOGI("NODE", "%s, radio on %lld ms", got ? "got the forecast" : "nothing from the hub",
+           (long long)(esp_timer_get_time() - startUs) / 1000);
+  return got;
+}
+
+#endif
@@ -0,0 +1,209 @@
+#include "probe.h"
+
+#if CONFIG_CYCLE_PROBES
+
+#include <stdio.h>
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#if CONFIG_HIL_BENCH
+#include "driver/gpio.h"
+#endif
+
+#define PROBE_MAGIC 0x50524231  // "PRB1"
+#define PROBE_HISTORY CONFIG_CYCLE_PROBE_HISTORY
+
+typedef struct {
+  uint32_t magic;
+  uint8_t head;  // Next slot to write
+  uint8_t count;
+  probe_record_t records[PROBE_HISTORY];
+} probe_ring_t;
+
+RTC_DATA_ATTR static probe_ring_t ring;
+
+// 0 when the stage isn't running (esp_timer starts just after reset, so a real start is never 0)
+static int64_t startedUs[PROBE_COUNT];
+static int64_t totalUs[PROBE_COUNT];
+static int64_t shownUs;
+static uint32_t rxBytes;
+static uint16_t batteryMv;
+static int8_t rssi;
+static uint8_t retries;
+
+static const char *const probeNames[PROBE_COUNT] = {
+    [PROBE_BOOT] = "boot",
+    [PROBE_WIFI_ASSOC] = "assoc",
+    [PROBE_DHCP] = "dhcp",
+    [PROBE_DNS] = "dns",
+    [PROBE_TCP] = "tcp",
+    [PROBE_TLS] = "tls",
+    [PROBE_FIRST_BYTE] = "ttfb",
+    [PROBE_BODY] = "body",
+    [PROBE_PARSE] = "parse",
+    [PROBE_RENDER] = "render",
+    [PROBE_SPI] = "spi",
+    [PROBE_BUSY] = "busy",
+    [PROBE_LISTEN] = "listen",
+    [PROBE_INIT] = "init",
+};
+
+#if CONFIG_HIL_BENCH
+// Every stage boundary is an edge, whichever core it happens on
+static inline void stageMarker(void)
+{
+  static uint32_t edges;
+  gpio_set_level(CONFIG_HIL_STAGE_GPIO, __atomic_add_fetch(&edges, 1, __ATOMIC_RELAXED) & 1);
+}
+
+// Console lines of their own, no log prefix, for host/hil/collect.py. The header goes out with
+// the first cycle after a reset.
+static void printCsv(const probe_record_t *rec)
+{
+  if (rec->cycle == 1) {
+    printf("csv,cycle,awake,shown");
+    for (int i = 0; i < PROBE_COUNT; i++) {
+      printf(",%s", probeNames[i]);
+    }
+    printf(",rx,rssi,bat,retries\n");
+  }
+  printf("csv,%lu,%u,%u", (unsigned long)rec->cycle, rec->awakeMs, rec->shownMs);
+  for (int i = 0; i < PROBE_COUNT; i++) {
+    printf(",%u", rec->stageMs[i]);
+  }
+  printf(",%lu,%d,%u,%u\n", (unsigned long)rec->rxBytes, rec->rssi, rec->batteryMv,
+         rec->retries);
+}
+#else
+static inline void stageMarker(void) {}
+#endif
+
+static uint16_t toMs(int64_t us)
+{
+  int64_t ms = (us + 500) / 1000;
+  return ms > UINT16_MAX ? UINT16_MAX : (uint16_t)ms;
+}
+
+void probeInit(void)
+{
+  if (ring.magic != PROBE_MAGIC || ring.head >= PROBE_HISTORY || ring.count > PROBE_HISTORY) {
+    ring = (probe_ring_t){.magic = PROBE_MAGIC};
+  }
+  totalUs[PROBE_BOOT] = esp_timer_get_time();
+
+#if CONFIG_HIL_BENCH
+  // Held low through deep sleep, let go before driving them again
+  gpio_hold_dis(CONFIG_HIL_AWAKE_GPIO);
+  gpio_hold_dis(CONFIG_HIL_STAGE_GPIO);
+  const gpio_config_t markers = {
+      .pin_bit_mask = (1ULL << CONFIG_HIL_AWAKE_GPIO) | (1ULL << CONFIG_HIL_STAGE_GPIO),
+      .mode = GPIO_MODE_OUTPUT,
+  };
+  ESP_ERROR_CHECK(gpio_config(&markers));
+  gpio_set_level(CONFIG_HIL_STAGE_GPIO, 0);
+  gpio_set_level(CONFIG_HIL_AWAKE_GPIO, 1);
+#endif
+}
+
+void probeBegin(probe_id_t id)
+{
+  if (!startedUs[id]) {
+    startedUs[id] = esp_timer_get_time();
+    stageMarker();
+  }
+}
+
+void probeEnd(probe_id_t id)
+{
+  if (startedUs[id]) {
+    int64_t now = esp_timer_get_time();
+    totalUs[id] += now - startedUs[id];
+    startedUs[id] = 0;
+    if (id == PROBE_BUSY) {
+      shownUs = now;
+    }
+    stageMarker();
+  }
+}
+
+void probeAddRx(size_t bytes)
+{
+  rxBytes += bytes;
+}
+
+void probeAddRetry(void)
+{
+  if (retries < UINT8_MAX) {
+    retries++;
+  }
+}
+
+void probeSetRssi(int8_t value)
+{
+  rssi = value;
+}
+
+void probeSetBattery(uint16_t mv)
+{
+  batteryMv = mv;
+}
+
+void probeFinish(uint32_t cycle)
+{
+  probe_record_t *rec = &ring.records[ring.head];
+  rec->cycle = cycle;
+  rec->awakeMs = toMs(esp_timer_get_time());
+  rec->shownMs = toMs(shownUs);
+  for (int i = 0; i < PROBE_COUNT; i++) {
+    rec->stageMs[i] = toMs(totalUs[i]);
+  }
+  rec->rxBytes = rxBytes;
+  rec->batteryMv = batteryMv;
+  rec->rssi = rssi;
+  rec->retries = retries;
+  ring.head = (ring.head + 1) % PROBE_HISTORY;
+  if (ring.count < PROBE_HISTORY) {
+    ring.count++;
+  }
+
+#if CONFIG_HIL_BENCH
+  // The analyzer's window closes with the record, and the pins stay low until the next wake
+  gpio_set_level(CONFIG_HIL_AWAKE_GPIO, 0);
+  gpio_set_level(CONFIG_HIL_STAGE_GPIO, 0);
+  gpio_hold_en(CONFIG_HIL_AWAKE_GPIO);
+  gpio_hold_en(CONFIG_HIL_STAGE_GPIO);
+  gpio_deep_sleep_hold_en();
+  printCsv(rec);
+#else
+  // One line, key=value, so it greps and parses easily off the serial log
+  char line[256];
+  int len = snprintf(line, sizeof(line), "cycle=%lu awake=%u shown=%u",
+                     (unsigned long)rec->cycle, rec->awakeMs, rec->shownMs);
+  for (int i = 0; i < PROBE_COUNT && len < (int)sizeof(line); i++) {
+    len += snprintf(line + len, sizeof(line) - len, " %s=%u", probeNames[i], rec->stageMs[i]);
+  }
+  if (len < (int)sizeof(line)) {
+    snprintf(line + len, sizeof(line) - len, " rx=%lu rssi=%d bat=%u retries=%u",
+             (unsigned long)rec->rxBytes, rec->rssi, rec->batteryMv, rec->retries);
+  }
+  ESP_LOGI("PROBE", "%s", line);
+#endif
+
+  // Everything before the radio is on is overhead every wake pays, keep it in check
+  unsigned startupMs = rec->stageMs[PROBE_BOOT] + rec->stageMs[PROBE_INIT];
+  if (startupMs > CONFIG_CYCLE_STARTUP_TARGET_MS) {
+    ESP_LOGW("PROBE", "startup took %u ms, target %d ms", startupMs,
+             CONFIG_CYCLE_STARTUP_TARGET_MS);
+  }
+}
+
+const probe_record_t *probeHistory(size_t age)
+{
+  if (age >= ring.count) {
+    return NULL;
+  }
+  return &ring.records[(ring.head + PROBE_HISTORY - 1 - age) % PROBE_HISTORY];
+}
+
+#endif
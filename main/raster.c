@@ -0,0 +1,196 @@
+#include "raster.h"
+
+// Words are loaded in CPU order but pixels run MSB first through each byte, so masks built with
+// the first pixel in the top bit get byte swapped before they touch a plane
+static inline uint32_t panelOrder(uint32_t v)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return __builtin_bswap32(v);
+#else
+  return v;
+#endif
+}
+
+static inline void applyWord(uint32_t *w, uint32_t mask, raster_op_t op)
+{
+  switch (op) {
+    case RASTER_CLEAR:
+      *w &= ~mask;
+      break;
+    case RASTER_SET:
+      *w |= mask;
+      break;
+    case RASTER_INVERT:
+      *w ^= mask;
+      break;
+  }
+}
+
+void rasterSpan(uint8_t *row, int x0, int x1, raster_op_t op)
+{
+  if (x1 <= x0) {
+    return;
+  }
+  uint32_t *w = (uint32_t *)row;
+  int first = x0 >> 5;
+  int last = (x1 - 1) >> 5;
+  uint32_t head = panelOrder(0xFFFFFFFFu >> (x0 & 31));
+  uint32_t tail = panelOrder(0xFFFFFFFFu << (31 - ((x1 - 1) & 31)));
+  if (first == last) {
+    applyWord(&w[first], head & tail, op);
+    return;
+  }
+
+  applyWord(&w[first], head, op);
+  if (op == RASTER_INVERT) {
+    for (int i = first + 1; i < last; i++) {
+      w[i] = ~w[i];
+    }
+  } else {
+    uint32_t fill = op == RASTER_SET ? 0xFFFFFFFFu : 0;
+    for (int i = first + 1; i < last; i++) {
+      w[i] = fill;
+    }
+  }
+  applyWord(&w[last], tail, op);
+}
+
+// Source word k with its first pixel in the top bit, zero past the end. Byte loads, glyph rows
+// sit at any alignment.
+static inline uint32_t sourceWord(const uint8_t *src, int bytes, int k)
+{
+  int i = k * 4;
+  if (i + 4 <= bytes) {
+    return (uint32_t)src[i] << 24 | (uint32_t)src[i + 1] << 16 | (uint32_t)src[i + 2] << 8 |
+           src[i + 3];
+  }
+  uint32_t v = 0;
+  for (int j = 0; i + j < bytes; j++) {
+    v |= (uint32_t)src[i + j] << (24 - 8 * j);
+  }
+  return v;
+}
+
+void rasterBlit(uint8_t *row, int x, const uint8_t *src, int width, bool set)
+{
+  if (width <= 0) {
+    return;
+  }
+  uint32_t *w = (uint32_t *)row + (x >> 5);
+  int shift = x & 31;
+  int bytes = (width + 7) >> 3;
+  int words = (shift + width + 31) >> 5;
+
+  // Each destination word is the source word shifted right, plus what fell off the one before
+  uint32_t carry = 0;
+  for (int k = 0; k < words; k++) {
+    uint32_t s = sourceWord(src, bytes, k);
+    uint32_t bits = shift ? s >> shift | carry : s;
+    carry = shift ? s << (32 - shift) : 0;
+    if (bits) {
+      uint32_t mask = panelOrder(bits);
+      w[k] = set ? w[k] | mask : w[k] & ~mask;
+    }
+  }
+}
+
+bool rasterDiff(const uint8_t *a, const uint8_t *b, fb_rect_t *bounds)
+{
+  enum { WORDS = FB_STRIDE / 4 };
+  const uint32_t *wa = (const uint32_t *)a;
+  const uint32_t *wb = (const uint32_t *)b;
+
+  // Every row's XOR ORed together column by column, so the sides fall out at the end
+  uint32_t cols[WORDS] = {0};
+  int top = -1;
+  int bottom = -1;
+  for (int y = 0; y < FB_HEIGHT; y++, wa += WORDS, wb += WORDS) {
+    uint32_t any = 0;
+    for (int i = 0; i < WORDS; i++) {
+      uint32_t d = wa[i] ^ wb[i];
+      cols[i] |= d;
+      any |= d;
+    }
+    if (any) {
+      top = top < 0 ? y : top;
+      bottom = y;
+    }
+  }
+  if (top < 0) {
+    return false;
+  }
+
+  int first = 0;
+  while (!cols[first]) {
+    first++;
+  }
+  int last = WORDS - 1;
+  while (!cols[last]) {
+    last--;
+  }
+  int x0 = first * 32 + __builtin_clz(panelOrder(cols[first]));
+  int x1 = last * 32 + 32 - __builtin_ctz(panelOrder(cols[last]));
+  *bounds = (fb_rect_t){.x = x0, .y = top, .w = x1 - x0, .h = bottom - top + 1};
+  return true;
+}
+
+// Mirror a word's 32 pixels. Reversing every bit of the CPU order word does it whichever way
+// round the bytes are.
+static inline uint32_t reverseBits(uint32_t v)
+{
+  v = (v >> 1 & 0x55555555u) | (v & 0x55555555u) << 1;
+  v = (v >> 2 & 0x33333333u) | (v & 0x33333333u) << 2;
+  v = (v >> 4 & 0x0F0F0F0Fu) | (v & 0x0F0F0F0Fu) << 4;
+  v = (v >> 8 & 0x00FF00FFu) | (v & 0x00FF00FFu) << 8;
+  return v >> 16 | v << 16;
+}
+
+void rasterRotate180(uint8_t *plane, int width, int height)
+{
+  // Upside down is the whole plane's pixels in reverse: swap words end for end, mirroring each
+  uint32_t *w = (uint32_t *)plane;
+  size_t n = (size_t)width / 32 * height;
+  for (size_t i = 0, j = n - 1; i < j; i++, j--) {
+    uint32_t t = reverseBits(w[i]);
+    w[i] = reverseBits(w[j]);
+    w[j] = t;
+  }
+  if (n & 1) {
+    w[n / 2] = reverseBits(w[n / 2]);
+  }
+}
+
+// Transpose an 8x8 block, row i in byte i from the top, pixel j of a row in bit 7 - j
+static inline uint64_t transpose8(uint64_t x)
+{
+  uint64_t t;
+  t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAull;
+  x ^= t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull;
+  x ^= t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull;
+  x ^= t ^ (t << 28);
+  return x;
+}
+
+void rasterRotate90(const uint8_t *src, int width, int height, uint8_t *dst)
+{
+  int srcStride = width / 8;
+  int dstStride = height / 8;
+  for (int by = 0; by < height; by += 8) {
+    // Source rows bottom first, so after the transpose each destination byte reads left to right
+    // up the source column
+    int dstByte = (height - 8 - by) / 8;
+    for (int bx = 0; bx < srcStride; bx++) {
+      uint64_t block = 0;
+      for (int r = 0; r < 8; r++) {
+        block |= (uint64_t)src[(size_t)(by + 7 - r) * srcStride + bx] << (56 - 8 * r);
+      }
+      block = transpose8(block);
+      uint8_t *out = dst + (size_t)bx * 8 * dstStride + dstByte;
+      for (int c = 0; c < 8; c++) {
+        out[(size_t)c * dstStride] = block >> (56 - 8 * c);
+      }
+    }
+  }
+}
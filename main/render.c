@@ -0,0 +1,123 @@
+#include "render.h"
+
+#include <stddef.h>
+
+#include "display.h"
+#include "epd.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/message_buffer.h"
+#include "freertos/task.h"
+#include "layout.h"
+#include "probe.h"
+
+// Wi-Fi and lwIP live on core 0, so drawing and SPI get core 1 to themselves
+#define RENDER_CORE (portNUM_PROCESSORS - 1)
+#define RENDER_PRIORITY 5
+#define RENDER_STACK_SIZE 4096
+
+typedef enum {
+  RENDER_SECTION,
+  RENDER_FIELD,
+  RENDER_SHOW,
+  RENDER_DISCARD,
+} render_msg_type_t;
+
+typedef struct {
+  uint8_t type;
+  uint8_t sections;
+  union {
+    weather_snapshot_t snap;  // RENDER_SECTION
+    weather_field_t field;    // RENDER_FIELD
+  };
+} render_msg_t;
+
+#define RENDER_CONTROL_LEN offsetof(render_msg_t, snap)
+#define RENDER_FIELD_LEN (RENDER_CONTROL_LEN + sizeof(weather_field_t))
+
+// Single producer (the fetch) and single consumer (the render task), which is what a message
+// buffer is for. Room for a couple of snapshots, the sender blocks if drawing falls behind.
+#define RENDER_BUF_SIZE (2 * (sizeof(render_msg_t) + sizeof(size_t)))
+
+static StaticMessageBuffer_t msgBufStruct;
+static uint8_t msgBufStorage[RENDER_BUF_SIZE + 1];
+static MessageBufferHandle_t msgBuf;
+
+static StaticTask_t taskStruct;
+static StackType_t taskStack[RENDER_STACK_SIZE];
+static TaskHandle_t waiter;
+
+static void renderTask(void *arg)
+{
+  // Static, the stack doesn't need to hold a snapshot at a time
+  static render_msg_t msg;
+
+  ESP_ERROR_CHECK(epdInit());
+  bool current;
+  framebuffer_t *fb = displayFrame(!arg, &current);
+  layoutBegin(current);
+
+  for (;;) {
+    xMessageBufferReceive(msgBuf, &msg, sizeof(msg), portMAX_DELAY);
+    if (msg.type == RENDER_SECTION) {
+      probeBegin(PROBE_RENDER);
+      layoutRender(fb, &msg.snap, msg.sections);
+      probeEnd(PROBE_RENDER);
+      continue;
+    } else if (msg.type == RENDER_FIELD) {
+      probeBegin(PROBE_RENDER);
+      layoutField(fb, &msg.field);
+      probeEnd(PROBE_RENDER);
+      continue;
+    }
+
+    esp_err_t err = ESP_OK;
+    fb_rect_t dirty;
+    if (msg.type == RENDER_SHOW && layoutDirty(&dirty)) {
+      err = displayShow(fb, &dirty);
+      if (err == ESP_OK) {
+        layoutCommit();
+      }
+    } else {
+      ESP_LOGI("RENDER", "nothing to show");
+    }
+
+    xTaskNotify(waiter, (uint32_t)err, eSetValueWithOverwrite);
+    vTaskDelete(NULL);
+  }
+}
+
+void renderStart(bool blank)
+{
+  msgBuf = xMessageBufferCreateStatic(RENDER_BUF_SIZE, msgBufStorage, &msgBufStruct);
+  xTaskCreateStaticPinnedToCore(renderTask, "render", RENDER_STACK_SIZE, (void *)blank,
+                                RENDER_PRIORITY, taskStack, &taskStruct, RENDER_CORE);
+}
+
+void renderSection(const weather_snapshot_t *snap, uint32_t sections)
+{
+  static render_msg_t msg;
+  msg.type = RENDER_SECTION;
+  msg.sections = sections;
+  msg.snap = *snap;
+  xMessageBufferSend(msgBuf, &msg, sizeof(msg), portMAX_DELAY);
+}
+
+void renderField(const weather_field_t *field)
+{
+  render_msg_t msg = {.type = RENDER_FIELD, .field = *field};
+  xMessageBufferSend(msgBuf, &msg, RENDER_FIELD_LEN, portMAX_DELAY);
+}
+
+esp_err_t renderFinish(bool show)
+{
+  const render_msg_t msg = {
+      .type = show ? RENDER_SHOW : RENDER_DISCARD,
+  };
+  waiter = xTaskGetCurrentTaskHandle();
+  xMessageBufferSend(msgBuf, &msg, RENDER_CONTROL_LEN, portMAX_DELAY);
+
+  uint32_t err;
+  xTaskNotifyWait(0, UINT32_MAX, &err, portMAX_DELAY);
+  return (esp_err_t)err;
+}
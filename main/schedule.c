@@ -0,0 +1,195 @@
+#include "schedule.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cycle.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#define US_PER_SEC 1000000LL
+#define DAY_SEC 86400
+
+#ifndef CONFIG_FORECAST_OFFLINE_RETRY_SEC
+// No forecast cache, a failed cycle always has nothing to show
+#define CONFIG_FORECAST_OFFLINE_RETRY_SEC CONFIG_REFRESH_RETRY_SEC
+#endif
+
+#ifndef CONFIG_REFRESH_LOW_BATTERY_MV
+// No battery monitor, the battery is never low
+#define CONFIG_REFRESH_LOW_BATTERY_MV 0
+#define CONFIG_REFRESH_LOW_BATTERY_SEC 0
+#endif
+
+// What this wake knows about the clock and the data, kept for the next
+typedef struct {
+  int64_t wallOffsetUs;  // Unix time minus cycleNowUs(), 0 until a Date header is seen
+  uint32_t freshUntil;   // Unix time the last response used goes stale, 0 for no hint
+  uint32_t dataTime;     // Observation time of the forecast on the panel, 0 if none yet
+  int32_t tzOffset;
+} schedule_plan_t;
+
+RTC_DATA_ATTR static schedule_plan_t plan;
+
+// Headers of the response in flight
+static struct {
+  int64_t wallOffsetUs;
+  uint32_t date;
+  uint32_t expires;
+  uint32_t age;
+  int32_t maxAge;  // -1 if not given
+  bool noCache;
+} pending = {.maxAge = -1};
+
+static uint16_t batteryMv;
+
+// IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT"), the only form servers still send. 0 if it
+// isn't one.
+static uint32_t parseHttpDate(const char *s)
+{
+  static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  char mon[4];
+  int day, year, hour, min, sec;
+  if (sscanf(s, "%*3s, %d %3s %d %d:%d:%d GMT", &day, mon, &year, &hour, &min, &sec) != 6) {
+    return 0;
+  }
+  const char *m = strstr(months, mon);
+  if (!m || (m - months) % 3 || strlen(mon) != 3 || year < 1970) {
+    return 0;
+  }
+  int month = (m - months) / 3 + 1;
+
+  // Days since the epoch from a civil date, with March as the first month of the year
+  int y = year - (month <= 2);
+  int era = y / 400;
+  int yoe = y - era * 400;
+  int doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  int64_t days = (int64_t)era * 146097 + doe - 719468;
+  return days * DAY_SEC + hour * 3600 + min * 60 + sec;
+}
+
+void scheduleHeader(const char *name, const char *value)
+{
+  if (strcmp(name, "date") == 0) {
+    pending.date = parseHttpDate(value);
+    pending.wallOffsetUs = (int64_t)pending.date * US_PER_SEC - cycleNowUs();
+  } else if (strcmp(name, "cache-control") == 0) {
+    const char *maxAge = strstr(value, "max-age=");
+    if (maxAge) {
+      pending.maxAge = strtol(maxAge + 8, NULL, 10);
+    }
+    pending.noCache = strstr(value, "no-cache") || strstr(value, "no-store");
+  } else if (strcmp(name, "expires") == 0) {
+    pending.expires = parseHttpDate(value);
+  } else if (strcmp(name, "age") == 0) {
+    pending.age = strtoul(value, NULL, 10);
+  }
+}
+
+void scheduleCommit(void)
+{
+  // Freshness is relative to the server's clock, no use without it
+  if (pending.date) {
+    plan.wallOffsetUs = pending.wallOffsetUs;
+    if (pending.noCache) {
+      plan.freshUntil = 0;
+    } else if (pending.maxAge >= 0) {
+      // max-age wins over Expires, and counts from when a cache in between first got it
+      int64_t left = (int64_t)pending.maxAge - pending.age;
+      plan.freshUntil = pending.date + (left > 0 ? left : 0);
+    } else {
+      plan.freshUntil = pending.expires > pending.date ? pending.expires : 0;
+    }
+  }
+  memset(&pending, 0, sizeof(pending));
+  pending.maxAge = -1;
+}
+
+void scheduleSetData(uint32_t time, int32_t tzOffset)
+{
+  plan.dataTime = time;
+  plan.tzOffset = tzOffset;
+}
+
+void scheduleSetBattery(uint16_t mv)
+{
+  batteryMv = mv;
+}
+
+// Seconds from local time of day sod to the end of quiet hours, 0 if it isn't in them
+static int64_t quietLeft(int64_t sod)
+{
+  int64_t start = CONFIG_REFRESH_QUIET_START_HOUR * 3600;
+  int64_t end = CONFIG_REFRESH_QUIET_END_HOUR * 3600;
+  bool quiet = start < end ? sod >= start && sod < end : sod >= start || sod < end;
+  if (start == end || !quiet) {
+    return 0;
+  }
+  return (end - sod + DAY_SEC) % DAY_SEC;
+}
+
+uint32_t scheduleNow(void)
+{
+  return plan.wallOffsetUs ? (cycleNowUs() + plan.wallOffsetUs) / US_PER_SEC : 0;
+}
+
+int64_t scheduleNextWake(int64_t nowUs, int64_t scheduledUs, schedule_mode_t mode)
+{
+  bool clock = plan.wallOffsetUs != 0;
+  int64_t wall = (nowUs + plan.wallOffsetUs) / US_PER_SEC;
+  const char *why;
+  int64_t next;
+
+  if (mode == SCHEDULE_RETRY) {
+    next = nowUs + (int64_t)CONFIG_REFRESH_RETRY_SEC * US_PER_SEC;
+    why = "retry";
+  } else if (mode == SCHEDULE_OFFLINE) {
+    next = nowUs + (int64_t)CONFIG_FORECAST_OFFLINE_RETRY_SEC * US_PER_SEC;
+    why = "offline";
+  } else {
+    if (clock && plan.freshUntil > wall) {
+      next = nowUs + (plan.freshUntil - wall) * US_PER_SEC;
+      why = "cache";
+    } else if (clock && plan.dataTime && CONFIG_REFRESH_DATA_PERIOD_SEC) {
+      // The first upstream update after now, plus a margin for it to reach the API
+      int64_t period = CONFIG_REFRESH_DATA_PERIOD_SEC;
+      int64_t due = plan.dataTime + ((wall - (int64_t)plan.dataTime) / period + 1) * period +
+                    CONFIG_REFRESH_DATA_MARGIN_SEC;
+      next = nowUs + (due - wall) * US_PER_SEC;
+      why = "data";
+    } else {
+      // A fixed cadence from when this wake was due, not from when it finished
+      next = scheduledUs + (int64_t)CONFIG_REFRESH_INTERVAL_SEC * US_PER_SEC;
+      if (next <= nowUs) {
+        next = nowUs + (int64_t)CONFIG_REFRESH_INTERVAL_SEC * US_PER_SEC;
+      }
+      why = "interval";
+    }
+
+    int64_t earliest = nowUs + (int64_t)CONFIG_REFRESH_MIN_SEC * US_PER_SEC;
+    int64_t latest = nowUs + (int64_t)CONFIG_REFRESH_MAX_SEC * US_PER_SEC;
+    next = next < earliest ? earliest : next > latest ? latest : next;
+  }
+
+  if (batteryMv && batteryMv < CONFIG_REFRESH_LOW_BATTERY_MV &&
+      next < nowUs + (int64_t)CONFIG_REFRESH_LOW_BATTERY_SEC * US_PER_SEC) {
+    next = nowUs + (int64_t)CONFIG_REFRESH_LOW_BATTERY_SEC * US_PER_SEC;
+    why = "low battery";
+  }
+
+  // Nobody's looking, and the first wake after is as fresh as any before it would have been
+  if (clock && plan.dataTime) {
+    int64_t local = (next + plan.wallOffsetUs) / US_PER_SEC + plan.tzOffset;
+    int64_t left = quietLeft((local % DAY_SEC + DAY_SEC) % DAY_SEC);
+    if (left) {
+      next += left * US_PER_SEC;
+      why = "quiet hours";
+    }
+  }
+
+  ESP_LOGI("SCHEDULE", "next wake in %lld s (%s)", (next - nowUs) / US_PER_SEC, why);
+  return next;
+}
@@ -0,0 +1,58 @@
+#include "snapshotAdvance.h"
+
+#include <string.h>
+
+#define HOUR_SEC 3600
+#define DAY_SEC 86400
+
+// Local calendar day, for comparing dates in the forecast's own zone
+static int64_t localDay(uint32_t time, int32_t tzOffset)
+{
+  int64_t t = (int64_t)time + tzOffset;
+  return t >= 0 ? t / DAY_SEC : (t - DAY_SEC + 1) / DAY_SEC;
+}
+
+bool snapshotAdvance(const weather_snapshot_t *from, uint32_t now, weather_snapshot_t *out)
+{
+  if (from->hourlyCount == 0 || now < from->hourlyStart) {
+    return false;
+  }
+  uint32_t hours = (now - from->hourlyStart) / HOUR_SEC;
+  if (hours >= from->hourlyCount) {
+    return false;
+  }
+
+  // Unused entries stay zero, so equal forecasts hash the same
+  memset(out, 0, sizeof(*out));
+  out->time = from->time;
+  out->tzOffset = from->tzOffset;
+  out->humidity = from->humidity;
+  out->aqi = from->aqi;
+
+  // The observation is better than any forecast for the hour it was made in
+  const weather_hour_t *h = &from->hourly[hours];
+  if (from->time >= from->hourlyStart + hours * HOUR_SEC) {
+    out->temp = from->temp;
+    out->feelsLike = from->feelsLike;
+    out->condition = from->condition;
+  } else {
+    out->temp = h->temp;
+    out->feelsLike = h->temp;
+    out->condition = h->condition;
+  }
+
+  out->hourlyCount = from->hourlyCount - hours;
+  out->hourlyStart = from->hourlyStart + hours * HOUR_SEC;
+  memcpy(out->hourly, &from->hourly[hours], out->hourlyCount * sizeof(weather_hour_t));
+
+  int64_t days = localDay(now, from->tzOffset) - localDay(from->dailyStart, from->tzOffset);
+  if (days < 0) {
+    days = 0;
+  }
+  if (days < from->dailyCount) {
+    out->dailyCount = from->dailyCount - days;
+    out->dailyStart = from->dailyStart + days * DAY_SEC;
+    memcpy(out->daily, &from->daily[days], out->dailyCount * sizeof(weather_day_t));
+  }
+  return true;
+}
@@ -0,0 +1,237 @@
+#include "snapshotCodec.h"
+
+#include <string.h>
+
+typedef struct {
+  uint8_t *buf;
+  size_t size;
+  size_t len;
+  bool overflow;
+} writer_t;
+
+typedef struct {
+  const uint8_t *buf;
+  size_t len;
+  size_t pos;
+  bool bad;
+} reader_t;
+
+static void putByte(writer_t *w, uint8_t b)
+{
+  if (w->len >= w->size) {
+    w->overflow = true;
+    return;
+  }
+  w->buf[w->len++] = b;
+}
+
+// LEB128, 7 bits a byte low first
+static void putUvarint(writer_t *w, uint32_t v)
+{
+  while (v >= 0x80) {
+    putByte(w, (v & 0x7F) | 0x80);
+    v >>= 7;
+  }
+  putByte(w, v);
+}
+
+// Zigzag first so small negative numbers stay small
+static void putSvarint(writer_t *w, int32_t v)
+{
+  putUvarint(w, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+static void putU32(writer_t *w, uint32_t v)
+{
+  for (int i = 0; i < 4; i++) {
+    putByte(w, v >> (8 * i));
+  }
+}
+
+// Conditions two to a byte, low nibble first
+static void putConditions(writer_t *w, const uint8_t *first, size_t stride, size_t count)
+{
+  for (size_t i = 0; i < count; i += 2) {
+    uint8_t b = first[i * stride] & 0x0F;
+    if (i + 1 < count) {
+      b |= (first[(i + 1) * stride] & 0x0F) << 4;
+    }
+    putByte(w, b);
+  }
+}
+
+static size_t encode(const weather_snapshot_t *s, size_t hours, uint8_t location, uint8_t *buf,
+                     size_t size)
+{
+  writer_t w = {.buf = buf, .size = size};
+  putByte(&w, SNAPSHOT_FRAME_MAGIC0);
+  putByte(&w, SNAPSHOT_FRAME_MAGIC1);
+  putByte(&w, SNAPSHOT_FRAME_VERSION);
+  putByte(&w, location);
+
+  putU32(&w, s->time);
+  // Every zone is a whole number of minutes off UTC
+  putSvarint(&w, s->tzOffset / 60);
+  putSvarint(&w, s->temp);
+  putSvarint(&w, s->feelsLike - s->temp);
+  putByte(&w, s->humidity);
+  putByte(&w, (s->condition & 0x0F) | (s->aqi << 4));
+  putByte(&w, hours);
+  putByte(&w, s->dailyCount);
+  putSvarint(&w, (int32_t)(s->hourlyStart - s->time));
+  putSvarint(&w, (int32_t)(s->dailyStart - s->time));
+
+  int16_t temp = s->temp;
+  uint8_t pop = 0;
+  for (size_t i = 0; i < hours; i++) {
+    const weather_hour_t *h = &s->hourly[i];
+    putSvarint(&w, h->temp - temp);
+    putSvarint(&w, h->pop - pop);
+    temp = h->temp;
+    pop = h->pop;
+  }
+  putConditions(&w, &s->hourly[0].condition, sizeof(weather_hour_t), hours);
+
+  temp = s->temp;
+  for (size_t i = 0; i < s->dailyCount; i++) {
+    const weather_day_t *d = &s->daily[i];
+    putSvarint(&w, d->tempMax - temp);
+    putSvarint(&w, d->tempMax - d->tempMin);
+    putByte(&w, d->pop);
+    temp = d->tempMax;
+  }
+  putConditions(&w, &s->daily[0].condition, sizeof(weather_day_t), s->dailyCount);
+
+  return w.overflow ? 0 : w.len;
+}
+
+size_t snapshotEncode(const weather_snapshot_t *snap, uint8_t location, uint8_t *buf,
+                      size_t size)
+{
+  size_t hours = snap->hourlyCount < WEATHER_HOURLY_MAX ? snap->hourlyCount : WEATHER_HOURLY_MAX;
+  for (;;) {
+    size_t len = encode(snap, hours, location, buf, size);
+    if (len || hours == 0) {
+      return len;
+    }
+    hours--;
+  }
+}
+
+static uint8_t getByte(reader_t *r)
+{
+  if (r->pos >= r->len) {
+    r->bad = true;
+    return 0;
+  }
+  return r->buf[r->pos++];
+}
+
+static uint32_t getUvarint(reader_t *r)
+{
+  uint32_t v = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    uint8_t b = getByte(r);
+    v |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      return v;
+    }
+  }
+  r->bad = true;
+  return 0;
+}
+
+static int32_t getSvarint(reader_t *r)
+{
+  uint32_t v = getUvarint(r);
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// Anything outside an int16 means a corrupt or hostile frame
+static int16_t toTemp(reader_t *r, int64_t v)
+{
+  if (v < INT16_MIN || v > INT16_MAX) {
+    r->bad = true;
+    return 0;
+  }
+  return v;
+}
+
+static uint8_t toPercent(reader_t *r, int64_t v)
+{
+  if (v < 0 || v > 100) {
+    r->bad = true;
+    return 0;
+  }
+  return v;
+}
+
+static void getConditions(reader_t *r, uint8_t *first, size_t stride, size_t count)
+{
+  for (size_t i = 0; i < count; i += 2) {
+    uint8_t b = getByte(r);
+    first[i * stride] = b & 0x0F;
+    if (i + 1 < count) {
+      first[(i + 1) * stride] = b >> 4;
+    } else if (b >> 4) {
+      r->bad = true;
+    }
+    if ((b & 0x0F) >= WEATHER_COND_COUNT || (b >> 4) >= WEATHER_COND_COUNT) {
+      r->bad = true;
+    }
+  }
+}
+
+bool snapshotDecode(const uint8_t *buf, size_t len, uint8_t *location, weather_snapshot_t *out)
+{
+  reader_t r = {.buf = buf, .len = len};
+  if (getByte(&r) != SNAPSHOT_FRAME_MAGIC0 || getByte(&r) != SNAPSHOT_FRAME_MAGIC1 ||
+      getByte(&r) != SNAPSHOT_FRAME_VERSION) {
+    return false;
+  }
+  *location = getByte(&r);
+
+  // Unused entries stay zero, so equal forecasts hash the same
+  memset(out, 0, sizeof(*out));
+  for (int i = 0; i < 4; i++) {
+    out->time |= (uint32_t)getByte(&r) << (8 * i);
+  }
+  int32_t tzMinutes = getSvarint(&r);
+  out->temp = toTemp(&r, getSvarint(&r));
+  out->feelsLike = toTemp(&r, (int64_t)out->temp + getSvarint(&r));
+  out->humidity = toPercent(&r, getByte(&r));
+  uint8_t b = getByte(&r);
+  out->condition = b & 0x0F;
+  out->aqi = b >> 4;
+  out->hourlyCount = getByte(&r);
+  out->dailyCount = getByte(&r);
+  out->hourlyStart = out->time + getSvarint(&r);
+  out->dailyStart = out->time + getSvarint(&r);
+  if (r.bad || tzMinutes < -24 * 60 || tzMinutes > 24 * 60 ||
+      out->condition >= WEATHER_COND_COUNT || out->aqi > 5 ||
+      out->hourlyCount > WEATHER_HOURLY_MAX || out->dailyCount > WEATHER_DAILY_MAX) {
+    return false;
+  }
+  out->tzOffset = tzMinutes * 60;
+
+  int32_t temp = out->temp;
+  int32_t pop = 0;
+  for (size_t i = 0; i < out->hourlyCount; i++) {
+    weather_hour_t *h = &out->hourly[i];
+    temp = h->temp = toTemp(&r, (int64_t)temp + getSvarint(&r));
+    pop = h->pop = toPercent(&r, (int64_t)pop + getSvarint(&r));
+  }
+  getConditions(&r, &out->hourly[0].condition, sizeof(weather_hour_t), out->hourlyCount);
+
+  temp = out->temp;
+  for (size_t i = 0; i < out->dailyCount; i++) {
+    weather_day_t *d = &out->daily[i];
+    temp = d->tempMax = toTemp(&r, (int64_t)temp + getSvarint(&r));
+    d->tempMin = toTemp(&r, (int64_t)d->tempMax - getSvarint(&r));
+    d->pop = toPercent(&r, getByte(&r));
+  }
+  getConditions(&r, &out->daily[0].condition, sizeof(weather_day_t), out->dailyCount);
+
+  // Trailing bytes mean we don't understand the frame after all
+  return !r.bad && r.pos == len;
+}
@@ -0,0 +1,171 @@
+#include "telemetry.h"
+
+#if CONFIG_TELEMETRY
+
+#include <stdio.h>
+#include <string.h>
+
+#include "arena.h"
+#include "cbor.h"
+#include "dnsCache.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "httpParser.h"
+#include "httpRequest.h"
+#include "netIo.h"
+#include "probe.h"
+
+#define TELEMETRY_VERSION 1
+// Can't wait for more records than the ring holds
+#if CONFIG_TELEMETRY_BATCH > CONFIG_CYCLE_PROBE_HISTORY
+#define TELEMETRY_BATCH CONFIG_CYCLE_PROBE_HISTORY
+#else
+#define TELEMETRY_BATCH CONFIG_TELEMETRY_BATCH
+#endif
+// Worst case encodings: the map with its keys, version, MAC and the record array head, then per
+// record its array heads, 5 bytes each for cycle and rxBytes and up to 3 for everything else
+#define TELEMETRY_HEADER_MAX 16
+#define TELEMETRY_RECORD_MAX (1 + 5 + 3 + 2 + 2 + 3 + 5 + 1 + 3 * PROBE_COUNT)
+#define TELEMETRY_HEAD_SIZE 256
+
+// Newest record the collector has acknowledged
+RTC_DATA_ATTR static uint32_t sentCycle;
+
+typedef struct {
+  int status;
+  http_parser_t parser;
+} post_ctx_t;
+
+static void onStatus(void *ctx, int status)
+{
+  ((post_ctx_t *)ctx)->status = status;
+}
+
+static size_t pendingRecords(void)
+{
+  const probe_record_t *newest = probeHistory(0);
+  if (newest && newest->cycle < sentCycle) {
+    // The boot counter went backwards, whatever we sent was another lifetime
+    sentCycle = 0;
+  }
+  size_t n = 0;
+  const probe_record_t *rec;
+  while ((rec = probeHistory(n)) && rec->cycle > sentCycle) {
+    n++;
+  }
+  return n;
+}
+
+static size_t encode(uint8_t *buf, size_t size, size_t count)
+{
+  cbor_writer_t w;
+  cborInit(&w, buf, size);
+  cborMap(&w, 3);
+
+  cborUint(&w, 0);
+  cborUint(&w, TELEMETRY_VERSION);
+
+  uint8_t mac[6] = {0};
+  esp_read_mac(mac, ESP_MAC_WIFI_STA);
+  cborUint(&w, 1);
+  cborBytes(&w, mac, sizeof(mac));
+
+  cborUint(&w, 2);
+  cborArray(&w, count);
+  for (size_t age = count; age-- > 0;) {
+    const probe_record_t *rec = probeHistory(age);
+    cborArray(&w, 7);
+    cborUint(&w, rec->cycle);
+    cborUint(&w, rec->awakeMs);
+    cborUint(&w, rec->retries);
+    cborInt(&w, rec->rssi);
+    cborUint(&w, rec->batteryMv);
+    cborUint(&w, rec->rxBytes);
+    cborArray(&w, PROBE_COUNT);
+    for (int i = 0; i < PROBE_COUNT; i++) {
+      cborUint(&w, rec->stageMs[i]);
+    }
+  }
+  return cborLength(&w);
+}
+
+// One POST on a fresh connection, true on a 2xx
+static bool post(const uint8_t *body, size_t len, char *head, post_ctx_t *ctx)
+{
+  int64_t deadlineUs = netDeadline(CONFIG_TELEMETRY_TIMEOUT_MS);
+  struct sockaddr_in dest = {
+      .sin_family = AF_INET,
+      .sin_port = htons(CONFIG_TELEMETRY_PORT),
+  };
+  if (dnsResolve(CONFIG_TELEMETRY_HOST, &dest.sin_addr, NULL, deadlineUs) != ESP_OK) {
+    ESP_LOGW("TELEMETRY", "DNS lookup failed");
+    return false;
+  }
+
+  int s = netConnect(&dest, deadlineUs);
+  if (s < 0) {
+    ESP_LOGW("TELEMETRY", "connect failed");
+    dnsInvalidate(CONFIG_TELEMETRY_HOST);
+    return false;
+  }
+
+  char length[12];
+  snprintf(length, sizeof(length), "%u", (unsigned)len);
+  http_request_t req;
+  httpRequestBegin(&req, head, TELEMETRY_HEAD_SIZE, "POST", CONFIG_TELEMETRY_HOST,
+                   CONFIG_TELEMETRY_PATH);
+  httpRequestHeader(&req, "Content-Type", "application/cbor");
+  httpRequestHeader(&req, "Content-Length", length);
+  httpRequestHeader(&req, "Connection", "close");
+  size_t headLen = httpRequestEnd(&req);
+
+  bool sent = headLen && netWrite(s, head, headLen, deadlineUs) >= 0 &&
+              netWrite(s, body, len, deadlineUs) >= 0;
+  if (sent) {
+    // Only the status matters, the request head buffer is free for reading into now
+    const http_callbacks_t cb = {.onStatus = onStatus, .ctx = ctx};
+    httpParserInit(&ctx->parser, &cb);
+    int r;
+    do {
+      r = netRead(s, head, TELEMETRY_HEAD_SIZE, deadlineUs);
+      if (r > 0) {
+        probeAddRx(r);
+        httpParserFeed(&ctx->parser, (uint8_t *)head, r);
+      } else if (r == 0) {
+        httpParserFinish(&ctx->parser);
+      }
+    } while (r > 0 && !httpParserDone(&ctx->parser) && !httpParserFailed(&ctx->parser));
+  }
+  close(s);
+
+  return ctx->status >= 200 && ctx->status < 300;
+}
+
+void telemetrySend(void)
+{
+  size_t count = pendingRecords();
+  if (count < TELEMETRY_BATCH) {
+    return;
+  }
+
+  size_t size = TELEMETRY_HEADER_MAX + count * TELEMETRY_RECORD_MAX;
+  uint8_t *body = arenaAlloc(size);
+  char *head = arenaAlloc(TELEMETRY_HEAD_SIZE);
+  post_ctx_t *ctx = arenaCalloc(1, sizeof(*ctx));
+  if (body && head && ctx) {
+    size_t len = encode(body, size, count);
+    if (len && post(body, len, head, ctx)) {
+      sentCycle = probeHistory(0)->cycle;
+      ESP_LOGI("TELEMETRY", "sent %u records, %u bytes", (unsigned)count, (unsigned)len);
+    } else {
+      ESP_LOGW("TELEMETRY", "upload failed (status %d), %u records pending", ctx->status,
+               (unsigned)count);
+    }
+  }
+  arenaFree(ctx);
+  arenaFree(head);
+  arenaFree(body);
+}
+
+#endif
@@ -0,0 +1,38 @@
+#include "text.h"
+
+static const glyph_t *lookup(const font_t *font, char c)
+{
+  unsigned idx = (uint8_t)c - font->first;
+  return idx < font->count ? &font->glyphs[idx] : NULL;
+}
+
+int textDraw(framebuffer_t *fb, const font_t *font, int x, int y, const char *text, uint8_t color)
+{
+  for (; *text; text++) {
+    const glyph_t *g = lookup(font, *text);
+    if (!g) {
+      continue;
+    }
+    if (g->width) {
+      const bitmap_t bm = {
+          .data = font->bitmap + g->offset,
+          .width = g->width,
+          .height = g->height,
+          .stride = g->stride,
+      };
+      fbBlit(fb, &bm, x, y + g->top, color);
+    }
+    x += g->advance;
+  }
+  return x;
+}
+
+int textWidth(const font_t *font, const char *text)
+{
+  int w = 0;
+  for (; *text; text++) {
+    const glyph_t *g = lookup(font, *text);
+    w += g ? g->advance : 0;
+  }
+  return w;
+}
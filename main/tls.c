@@ -0,0 +1,214 @@
+#include "tls.h"
+
+#include <string.h>
+
+#include "arena.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "mbedtls/x509_crt.h"
+#include "netIo.h"
+#include "sdkconfig.h"
+
+// Root CA of the weather API, embedded as DER so it's parsed in place with no base64 decode or
+// copy of the certificate
+extern const uint8_t weatherApiCaStart[] asm("_binary_weather_api_ca_der_start");
+extern const uint8_t weatherApiCaEnd[] asm("_binary_weather_api_ca_der_end");
+
+// Config and CA chain are set up on first use and shared by every connection this wake
+static mbedtls_ssl_config conf;
+static mbedtls_x509_crt caChain;
+static bool confReady = false;
+
+// Serialized session (ticket + master secret) from the last connection, survives deep sleep so
+// the next wake can do an abbreviated handshake
+RTC_DATA_ATTR static uint8_t savedSession[CONFIG_TLS_SESSION_MAX];
+RTC_DATA_ATTR static size_t savedSessionLen;
+
+#if CONFIG_MBEDTLS_CUSTOM_MEM_ALLOC
+// All of mbedTLS allocates through these, the record buffers and handshake scratch included, so
+// TLS works out of the cycle arena rather than the heap. Big number temporaries are freed in
+// roughly the order they're allocated, which the arena reclaims; if it does fill up anyway the
+// heap takes over.
+void *esp_mbedtls_mem_calloc(size_t n, size_t size)
+{
+  void *ptr = arenaCalloc(n, size);
+  return ptr ? ptr : heap_caps_calloc(n, size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+void esp_mbedtls_mem_free(void *ptr)
+{
+  if (arenaOwns(ptr)) {
+    arenaFree(ptr);
+  } else {
+    heap_caps_free(ptr);
+  }
+}
+#endif
+
+// The hardware RNG is a true RNG while the radio is on, which it is whenever we're talking TLS
+static int hwRandom(void *ctx, unsigned char *buf, size_t len)
+{
+  esp_fill_random(buf, len);
+  return 0;
+}
+
+static esp_err_t confInit(void)
+{
+  if (confReady) {
+    return ESP_OK;
+  }
+
+  mbedtls_x509_crt_init(&caChain);
+  int ret = mbedtls_x509_crt_parse_der_nocopy(&caChain, weatherApiCaStart,
+                                              weatherApiCaEnd - weatherApiCaStart);
+  if (ret != 0) {
+    ESP_LOGE("TLS", "CA parse failed -0x%x", -ret);
+    return ESP_FAIL;
+  }
+
+  mbedtls_ssl_config_init(&conf);
+  ret = mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                    MBEDTLS_SSL_PRESET_DEFAULT);
+  if (ret != 0) {
+    ESP_LOGE("TLS", "config failed -0x%x", -ret);
+    return ESP_FAIL;
+  }
+  mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+  mbedtls_ssl_conf_ca_chain(&conf, &caChain, NULL);
+  mbedtls_ssl_conf_rng(&conf, hwRandom, NULL);
+  // TLS 1.2 tickets resume with a single round trip and serialize to a couple of hundred bytes
+  mbedtls_ssl_conf_max_tls_version(&conf, MBEDTLS_SSL_VERSION_TLS1_2);
+  mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+
+  confReady = true;
+  return ESP_OK;
+}
+
+void tlsDeinit(void)
+{
+  if (!confReady) {
+    return;
+  }
+  mbedtls_ssl_config_free(&conf);
+  mbedtls_x509_crt_free(&caChain);
+  confReady = false;
+}
+
+// Offer the session from the last wake, if we have one
+static void restoreSession(tls_conn_t *conn)
+{
+  if (savedSessionLen == 0) {
+    return;
+  }
+
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  if (mbedtls_ssl_session_load(&session, savedSession, savedSessionLen) == 0) {
+    mbedtls_ssl_set_session(&conn->ssl, &session);
+  } else {
+    savedSessionLen = 0;
+  }
+  mbedtls_ssl_session_free(&session);
+}
+
+static void saveSession(tls_conn_t *conn)
+{
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+
+  size_t len = 0;
+  if (mbedtls_ssl_get_session(&conn->ssl, &session) != 0 ||
+      mbedtls_ssl_session_save(&session, savedSession, sizeof(savedSession), &len) != 0) {
+    len = 0;
+  }
+  savedSessionLen = len;
+  mbedtls_ssl_session_free(&session);
+}
+
+// The socket is non-blocking, so WANT_READ/WANT_WRITE mean wait for it. False once the deadline
+// has passed (or for any other error).
+static bool waitSocket(tls_conn_t *conn, int ret)
+{
+  if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    return false;
+  }
+  return netWait(conn->net.fd, ret == MBEDTLS_ERR_SSL_WANT_WRITE, conn->deadlineUs);
+}
+
+esp_err_t tlsConnect(tls_conn_t *conn, int fd, const char *host, int64_t deadlineUs)
+{
+  if (confInit() != ESP_OK) {
+    return ESP_FAIL;
+  }
+
+  mbedtls_ssl_init(&conn->ssl);
+  conn->net.fd = fd;
+  conn->deadlineUs = deadlineUs;
+
+  int ret = mbedtls_ssl_setup(&conn->ssl, &conf);
+  if (ret == 0) {
+    ret = mbedtls_ssl_set_hostname(&conn->ssl, host);
+  }
+  if (ret != 0) {
+    ESP_LOGE("TLS", "setup failed -0x%x", -ret);
+    mbedtls_ssl_free(&conn->ssl);
+    return ESP_FAIL;
+  }
+  mbedtls_ssl_set_bio(&conn->ssl, &conn->net, mbedtls_net_send, mbedtls_net_recv, NULL);
+  restoreSession(conn);
+  bool resuming = savedSessionLen != 0;
+
+  while ((ret = mbedtls_ssl_handshake(&conn->ssl)) != 0) {
+    if (!waitSocket(conn, ret)) {
+      if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        ESP_LOGE("TLS", "handshake timed out");
+      } else {
+        ESP_LOGE("TLS", "handshake failed -0x%x", -ret);
+        // A rejected ticket falls back to a full handshake on its own, so this is something else
+        savedSessionLen = 0;
+      }
+      mbedtls_ssl_free(&conn->ssl);
+      return ESP_FAIL;
+    }
+  }
+
+  ESP_LOGI("TLS", "handshake done (%s)", resuming ? "resumption offered" : "full");
+  saveSession(conn);
+  return ESP_OK;
+}
+
+int tlsRead(tls_conn_t *conn, uint8_t *buf, size_t len)
+{
+  int ret;
+  do {
+    ret = mbedtls_ssl_read(&conn->ssl, buf, len);
+  } while (ret < 0 && waitSocket(conn, ret));
+
+  // A close_notify is a normal end of the response
+  return ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY ? 0 : ret;
+}
+
+int tlsWrite(tls_conn_t *conn, const uint8_t *buf, size_t len)
+{
+  size_t done = 0;
+  while (done < len) {
+    int ret = mbedtls_ssl_write(&conn->ssl, buf + done, len - done);
+    if (ret > 0) {
+      done += ret;
+    } else if (!waitSocket(conn, ret)) {
+      return ret < 0 ? ret : MBEDTLS_ERR_SSL_TIMEOUT;
+    }
+  }
+  return (int)done;
+}
+
+void tlsClose(tls_conn_t *conn)
+{
+  // Servers can hand out a fresh ticket after the handshake, pick up whatever we hold now
+  saveSession(conn);
+  mbedtls_ssl_close_notify(&conn->ssl);
+  mbedtls_ssl_free(&conn->ssl);
+  mbedtls_net_free(&conn->net);
+}
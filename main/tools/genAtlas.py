@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""Pack the text-art font and icons in main/assets into 1bpp const arrays.
+
+Runs as a build step (see main/CMakeLists.txt) so nothing is decoded or rasterized on the
+device: glyphs come out pre-scaled, trimmed and with their metrics worked out, rows MSB-first
+like the framebuffer so the blitter can copy them straight in. The names emitted here have to
+match the declarations in include/atlas.h.
+"""
+
+import argparse
+import sys
+
+# Name, scale. The 5x7 source is scaled up by whole pixels, it's a weather display not a book.
+FONTS = [("fontSmall", 2), ("fontMedium", 3), ("fontLarge", 6)]
+ICONS = [("iconsSmall", 1), ("iconsLarge", 2)]
+
+FONT_FIRST = 0x20
+FONT_COUNT = 96
+FONT_ASCENT = 7  # Rows above the baseline in the source
+FONT_DESCENT = 2
+
+
+def readBlocks(path):
+    """Yield (header, rows) for each blank line separated block, skipping comments."""
+    header, rows = None, []
+    with open(path) as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if line.startswith("# "):
+                continue
+            if not line.strip():
+                if header is not None:
+                    yield header, rows
+                header, rows = None, []
+            elif header is None:
+                header = line
+            else:
+                rows.append([c == "#" for c in line])
+    if header is not None:
+        yield header, rows
+
+
+def scale(rows, s):
+    return [[px for px in row for _ in range(s)] for row in rows for _ in range(s)]
+
+
+def stride(width):
+    # Wide rows are padded to whole words so the blitter can take its 32 bit path
+    n = (width + 7) // 8
+    return (n + 3) & ~3 if n > 2 else n
+
+
+def pack(rows, width):
+    out = bytearray()
+    for row in rows:
+        bits = row + [False] * (stride(width) * 8 - len(row))
+        for i in range(0, len(bits), 8):
+            out.append(sum(1 << (7 - j) for j, b in enumerate(bits[i:i + 8]) if b))
+    return out
+
+
+def trim(rows):
+    """Drop blank columns either side and blank rows top and bottom, returning the offsets."""
+    cols = [x for row in rows for x, b in enumerate(row) if b]
+    inked = [y for y, row in enumerate(rows) if any(row)]
+    if not cols:
+        return [], 0, 0
+    x0, x1 = min(cols), max(cols) + 1
+    return [row[x0:x1] + [False] * (x1 - len(row)) for row in rows[inked[0]:inked[-1] + 1]], x0, \
+        inked[0]
+
+
+def hexBytes(data, indent="    "):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append(indent + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return "\n".join(lines)
+
+
+def loadFont(path):
+    glyphs = {}
+    for header, rows in readBlocks(path):
+        code = int(header.split()[0], 0)
+        if not FONT_FIRST <= code < FONT_FIRST + FONT_COUNT:
+            sys.exit("%s: glyph 0x%02x out of range" % (path, code))
+        glyphs[code] = rows
+    missing = [c for c in range(FONT_FIRST, FONT_FIRST + FONT_COUNT) if c not in glyphs]
+    if missing:
+        sys.exit("%s: missing glyphs %s" % (path, ", ".join("0x%02x" % c for c in missing)))
+    return glyphs
+
+
+def emitFont(name, s, glyphs):
+    bitmap = bytearray()
+    metrics = []
+    for code in range(FONT_FIRST, FONT_FIRST + FONT_COUNT):
+        src = glyphs[code]
+        rows, _, top = trim(src)
+        if not rows:
+            # Blank (space): just an advance, as wide as it was drawn
+            metrics.append((0, 0, 0, 0, 0, len(src[0]) * s))
+            continue
+        rows = scale(rows, s)
+        w, h = len(rows[0]), len(rows)
+        if stride(w) % 4 == 0:
+            bitmap += bytes(-len(bitmap) % 4)
+        metrics.append((len(bitmap), w, h, stride(w), (top - FONT_ASCENT) * s, w + s))
+        bitmap += pack(rows, w)
+    if len(bitmap) > 0xFFFF:
+        sys.exit("%s: bitmap too big for 16 bit offsets" % name)
+
+    out = ["static const uint8_t %sBitmap[] __attribute__((aligned(4))) = {" % name,
+           hexBytes(bitmap), "};", "",
+           "static const glyph_t %sGlyphs[%d] = {" % (name, FONT_COUNT)]
+    for code, m in zip(range(FONT_FIRST, FONT_FIRST + FONT_COUNT), metrics):
+        out.append("    {%d, %d, %d, %d, %d, %d},  // 0x%02x" % (m + (code,)))
+    out += ["};", "",
+            "const font_t %s = {" % name,
+            "    .bitmap = %sBitmap," % name,
+            "    .glyphs = %sGlyphs," % name,
+            "    .first = 0x%02x," % FONT_FIRST,
+            "    .count = %d," % FONT_COUNT,
+            "    .ascent = %d," % (FONT_ASCENT * s),
+            "    .lineHeight = %d," % ((FONT_ASCENT + FONT_DESCENT + 1) * s),
+            "};", ""]
+    return out
+
+
+def emitIcons(name, s, icons):
+    out = []
+    for cond, rows in icons:
+        rows = scale(rows, s)
+        w, h = len(rows[0]), len(rows)
+        out += ["static const uint8_t %s_%s[] __attribute__((aligned(4))) = {" % (name, cond),
+                hexBytes(pack(rows, w)), "};", ""]
+    out.append("const bitmap_t %s[WEATHER_COND_COUNT] = {" % name)
+    for cond, rows in icons:
+        w, h = len(rows[0]) * s, len(rows) * s
+        out.append("    [WEATHER_COND_%s] = {%s_%s, %d, %d, %d}," % (cond, name, cond, w, h,
+                                                                   stride(w)))
+    out += ["};", ""]
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--font", required=True)
+    ap.add_argument("--icons", required=True)
+    ap.add_argument("-o", "--output", required=True)
+    args = ap.parse_args()
+
+    glyphs = loadFont(args.font)
+    icons = []
+    for header, rows in readBlocks(args.icons):
+        kind, cond = header.split()
+        if kind != "icon" or len({len(r) for r in rows}) != 1:
+            sys.exit("%s: bad icon %s" % (args.icons, cond))
+        icons.append((cond, rows))
+
+    out = ["// Generated by tools/genAtlas.py from assets/, do not edit", "",
+           '#include "atlas.h"', ""]
+    for name, s in FONTS:
+        out += emitFont(name, s, glyphs)
+    for name, s in ICONS:
+        out += emitIcons(name, s, icons)
+
+    with open(args.output, "w") as f:
+        f.write("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,389 @@
+#include "weatherJson.h"
+
+#include <string.h>
+
+// Member names we care about, everything else maps to JSON_KEY_OTHER
+enum {
+  KEY_CURRENT = 1,
+  KEY_HOURLY,
+  KEY_DAILY,
+  KEY_DT,
+  KEY_TEMP,
+  KEY_FEELS_LIKE,
+  KEY_HUMIDITY,
+  KEY_WEATHER,
+  KEY_ID,
+  KEY_MIN,
+  KEY_MAX,
+  KEY_POP,
+  KEY_TZ_OFFSET,
+  KEY_LIST,
+  KEY_MAIN,
+  KEY_AQI,
+};
+
+static const char *const weatherKeys[] = {
+    "current", "hourly", "daily", "dt",   "temp", "feels_like",      "humidity",
+    "weather", "id",     "min",   "max",  "pop",  "timezone_offset", "list",
+    "main",    "aqi",
+};
+
+weather_condition_t weatherConditionFromCode(int code)
+{
+  // https://openweathermap.org/weather-conditions
+  switch (code / 100) {
+    case 2:
+      return WEATHER_COND_THUNDER;
+    case 3:
+      return WEATHER_COND_DRIZZLE;
+    case 5:
+      return code == 511 ? WEATHER_COND_SNOW : WEATHER_COND_RAIN;
+    case 6:
+      return WEATHER_COND_SNOW;
+    case 7:
+      return WEATHER_COND_MIST;
+    case 8:
+      if (code == 800) {
+        return WEATHER_COND_CLEAR;
+      } else if (code == 801) {
+        return WEATHER_COND_FEW_CLOUDS;
+      } else if (code == 802) {
+        return WEATHER_COND_CLOUDS;
+      }
+      return WEATHER_COND_OVERCAST;
+    default:
+      return WEATHER_COND_UNKNOWN;
+  }
+}
+
+static inline uint8_t keyAt(const json_parser_t *json, uint8_t level)
+{
+  return jsonFrame(json, level)->key;
+}
+
+static inline uint16_t indexAt(const json_parser_t *json, uint8_t level)
+{
+  return jsonFrame(json, level)->index;
+}
+
+// Temperatures/percentages clamp rather than wrap
+static int16_t toTemp(const char *text, size_t len)
+{
+  int32_t v = jsonToFixed(text, len, 1);
+  return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : (int16_t)v;
+}
+
+static uint8_t toPercent(int32_t v)
+{
+  return v < 0 ? 0 : v > 100 ? 100 : (uint8_t)v;
+}
+
+static void apply(weather_snapshot_t *out, const weather_field_t *f)
+{
+  uint16_t i = f->index;
+  weather_hour_t *hour = NULL;
+  weather_day_t *day = NULL;
+  if (f->id >= WEATHER_FIELD_HOUR_TIME && f->id <= WEATHER_FIELD_HOUR_CONDITION) {
+    if (i >= WEATHER_HOURLY_MAX) {
+      return;
+    }
+    hour = &out->hourly[i];
+    if (i >= out->hourlyCount) {
+      out->hourlyCount = i + 1;
+    }
+  } else if (f->id >= WEATHER_FIELD_DAY_TIME && f->id <= WEATHER_FIELD_DAY_CONDITION) {
+    if (i >= WEATHER_DAILY_MAX) {
+      return;
+    }
+    day = &out->daily[i];
+    if (i >= out->dailyCount) {
+      out->dailyCount = i + 1;
+    }
+  }
+
+  switch (f->id) {
+    case WEATHER_FIELD_TZ_OFFSET:
+      out->tzOffset = f->value;
+      break;
+    case WEATHER_FIELD_TIME:
+      out->time = (uint32_t)f->value;
+      break;
+    case WEATHER_FIELD_TEMP:
+      out->temp = f->value;
+      break;
+    case WEATHER_FIELD_FEELS_LIKE:
+      out->feelsLike = f->value;
+      break;
+    case WEATHER_FIELD_HUMIDITY:
+      out->humidity = f->value;
+      break;
+    case WEATHER_FIELD_CONDITION:
+      out->condition = f->value;
+      break;
+    case WEATHER_FIELD_AQI:
+      out->aqi = f->value;
+      break;
+    case WEATHER_FIELD_HOUR_TIME:
+      // Entries are an hour apart, only the first one's time is kept
+      if (i == 0) {
+        out->hourlyStart = (uint32_t)f->value;
+      }
+      break;
+    case WEATHER_FIELD_HOUR_TEMP:
+      hour->temp = f->value;
+      break;
+    case WEATHER_FIELD_HOUR_POP:
+      hour->pop = f->value;
+      break;
+    case WEATHER_FIELD_HOUR_CONDITION:
+      hour->condition = f->value;
+      break;
+    case WEATHER_FIELD_DAY_TIME:
+      if (i == 0) {
+        out->dailyStart = (uint32_t)f->value;
+      }
+      break;
+    case WEATHER_FIELD_DAY_TEMP_MIN:
+      day->tempMin = f->value;
+      break;
+    case WEATHER_FIELD_DAY_TEMP_MAX:
+      day->tempMax = f->value;
+      break;
+    case WEATHER_FIELD_DAY_POP:
+      day->pop = f->value;
+      break;
+    case WEATHER_FIELD_DAY_CONDITION:
+      day->condition = f->value;
+      break;
+    default:
+      break;
+  }
+}
+
+// Into the snapshot, and/or out as an event
+static void emit(weather_parser_t *parser, weather_field_id_t id, uint16_t index, int32_t value)
+{
+  const weather_field_t field = {.id = id, .index = index, .value = value};
+  if (parser->out) {
+    apply(parser->out, &field);
+  }
+  if (parser->onField) {
+    parser->onField(parser->ctx, &field);
+  }
+}
+
+static void onCurrent(weather_parser_t *parser, uint8_t depth, uint8_t key, const char *text,
+                      size_t len)
+{
+  const json_parser_t *json = &parser->json;
+
+  if (depth == 2) {
+    switch (key) {
+      case KEY_DT:
+        emit(parser, WEATHER_FIELD_TIME, 0, jsonToFixed(text, len, 0));
+        parser->found = true;
+        break;
+      case KEY_TEMP:
+        emit(parser, WEATHER_FIELD_TEMP, 0, toTemp(text, len));
+        break;
+      case KEY_FEELS_LIKE:
+        emit(parser, WEATHER_FIELD_FEELS_LIKE, 0, toTemp(text, len));
+        break;
+      case KEY_HUMIDITY:
+        emit(parser, WEATHER_FIELD_HUMIDITY, 0, toPercent(jsonToFixed(text, len, 0)));
+        break;
+      default:
+        break;
+    }
+  } else if (depth == 4 && keyAt(json, 1) == KEY_WEATHER && indexAt(json, 2) == 0 &&
+             key == KEY_ID) {
+    // Only the primary condition
+    emit(parser, WEATHER_FIELD_CONDITION, 0, weatherConditionFromCode(jsonToFixed(text, len, 0)));
+  }
+}
+
+static void onHourly(weather_parser_t *parser, uint8_t depth, uint8_t key, const char *text,
+                     size_t len)
+{
+  const json_parser_t *json = &parser->json;
+  uint16_t i = indexAt(json, 1);
+
+  if (depth == 3) {
+    switch (key) {
+      case KEY_DT:
+        emit(parser, WEATHER_FIELD_HOUR_TIME, i, jsonToFixed(text, len, 0));
+        break;
+      case KEY_TEMP:
+        emit(parser, WEATHER_FIELD_HOUR_TEMP, i, toTemp(text, len));
+        break;
+      case KEY_POP:
+        emit(parser, WEATHER_FIELD_HOUR_POP, i, toPercent(jsonToFixed(text, len, 2)));
+        break;
+      default:
+        break;
+    }
+  } else if (depth == 5 && keyAt(json, 2) == KEY_WEATHER && indexAt(json, 3) == 0 &&
+             key == KEY_ID) {
+    emit(parser, WEATHER_FIELD_HOUR_CONDITION, i,
+         weatherConditionFromCode(jsonToFixed(text, len, 0)));
+  }
+}
+
+static void onDaily(weather_parser_t *parser, uint8_t depth, uint8_t key, const char *text,
+                    size_t len)
+{
+  const json_parser_t *json = &parser->json;
+  uint16_t i = indexAt(json, 1);
+
+  if (depth == 3) {
+    if (key == KEY_DT) {
+      emit(parser, WEATHER_FIELD_DAY_TIME, i, jsonToFixed(text, len, 0));
+    } else if (key == KEY_POP) {
+      emit(parser, WEATHER_FIELD_DAY_POP, i, toPercent(jsonToFixed(text, len, 2)));
+    }
+  } else if (depth == 4 && keyAt(json, 2) == KEY_TEMP) {
+    if (key == KEY_MIN) {
+      emit(parser, WEATHER_FIELD_DAY_TEMP_MIN, i, toTemp(text, len));
+    } else if (key == KEY_MAX) {
+      emit(parser, WEATHER_FIELD_DAY_TEMP_MAX, i, toTemp(text, len));
+    }
+  } else if (depth == 5 && keyAt(json, 2) == KEY_WEATHER && indexAt(json, 3) == 0 &&
+             key == KEY_ID) {
+    emit(parser, WEATHER_FIELD_DAY_CONDITION, i,
+         weatherConditionFromCode(jsonToFixed(text, len, 0)));
+  }
+}
+
+// Air pollution has the index at list[0].main.aqi
+static void onAir(weather_parser_t *parser, uint8_t depth, uint8_t key, const char *text,
+                  size_t len)
+{
+  const json_parser_t *json = &parser->json;
+  if (depth == 4 && jsonFrame(json, 1)->isArray && indexAt(json, 1) == 0 &&
+      keyAt(json, 2) == KEY_MAIN && key == KEY_AQI) {
+    int32_t aqi = jsonToFixed(text, len, 0);
+    emit(parser, WEATHER_FIELD_AQI, 0, aqi < 0 ? 0 : aqi > 5 ? 5 : aqi);
+    parser->found = true;
+  }
+}
+
+// END events come after the pop, so a section has just closed when we're back at the root
+static void sectionEnd(weather_parser_t *parser, const json_parser_t *json)
+{
+  weather_section_t section;
+  switch (keyAt(json, 0)) {
+    case KEY_CURRENT:
+      section = WEATHER_SECTION_CURRENT;
+      break;
+    case KEY_HOURLY:
+      section = WEATHER_SECTION_HOURLY;
+      break;
+    case KEY_DAILY:
+      section = WEATHER_SECTION_DAILY;
+      break;
+    case KEY_LIST:
+      section = WEATHER_SECTION_AIR;
+      break;
+    default:
+      return;
+  }
+  if (parser->onSection) {
+    parser->onSection(parser->ctx, parser->out, section);
+  }
+  if (parser->onField) {
+    const weather_field_t field = {.id = WEATHER_FIELD_SECTION_END, .value = section};
+    parser->onField(parser->ctx, &field);
+  }
+}
+
+static void onJson(void *ctx, const json_parser_t *json, json_event_t event, const char *text,
+                   size_t len)
+{
+  weather_parser_t *parser = ctx;
+  uint8_t depth = jsonDepth(json);
+
+  if ((event == JSON_OBJECT_END || event == JSON_ARRAY_END) && depth == 1 &&
+      !jsonFrame(json, 0)->isArray) {
+    sectionEnd(parser, json);
+    return;
+  }
+
+  // Every field we want is a number inside the root object
+  if (event != JSON_NUMBER || depth == 0 || jsonFrame(json, 0)->isArray) {
+    return;
+  }
+  uint8_t key = keyAt(json, depth - 1);
+
+  if (parser->air) {
+    if (keyAt(json, 0) == KEY_LIST) {
+      onAir(parser, depth, key, text, len);
+    }
+    return;
+  }
+
+  switch (keyAt(json, 0)) {
+    case KEY_TZ_OFFSET:
+      if (depth == 1) {
+        emit(parser, WEATHER_FIELD_TZ_OFFSET, 0, jsonToFixed(text, len, 0));
+      }
+      break;
+    case KEY_CURRENT:
+      onCurrent(parser, depth, key, text, len);
+      break;
+    case KEY_HOURLY:
+      if (depth >= 3 && jsonFrame(json, 1)->isArray) {
+        onHourly(parser, depth, key, text, len);
+      }
+      break;
+    case KEY_DAILY:
+      if (depth >= 3 && jsonFrame(json, 1)->isArray) {
+        onDaily(parser, depth, key, text, len);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+static void init(weather_parser_t *parser, weather_snapshot_t *out, bool air,
+                 weather_section_cb_t onSection, void *ctx)
+{
+  parser->out = out;
+  parser->air = air;
+  parser->found = false;
+  parser->onSection = onSection;
+  parser->onField = NULL;
+  parser->ctx = ctx;
+  jsonParserInit(&parser->json, weatherKeys, sizeof(weatherKeys) / sizeof(weatherKeys[0]), onJson,
+                 parser);
+}
+
+void weatherParserInit(weather_parser_t *parser, weather_snapshot_t *out,
+                       weather_section_cb_t onSection, void *ctx)
+{
+  memset(out, 0, sizeof(*out));
+  init(parser, out, false, onSection, ctx);
+}
+
+void weatherAirParserInit(weather_parser_t *parser, weather_snapshot_t *out,
+                          weather_section_cb_t onSection, void *ctx)
+{
+  init(parser, out, true, onSection, ctx);
+}
+
+void weatherFieldParserInit(weather_parser_t *parser, bool air, weather_field_cb_t onField,
+                            void *ctx)
+{
+  init(parser, NULL, air, NULL, ctx);
+  parser->onField = onField;
+}
+
+void weatherParserFeed(weather_parser_t *parser, const uint8_t *data, size_t len)
+{
+  jsonParserFeed(&parser->json, data, len);
+}
+
+bool weatherParserFinish(weather_parser_t *parser)
+{
+  return jsonParserFinish(&parser->json) && parser->found;
+}
@@ -0,0 +1,401 @@
+#include "wifi.h"
+
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/event_groups.h"
+#include "lwip/inet.h"
+#include "nvs.h"
+#include "probe.h"
+#include "sdkconfig.h"
+
+#define WIFI_SSID CONFIG_ESP_WIFI_SSID
+#define WIFI_PASS CONFIG_ESP_WIFI_PASS
+#define WIFI_RETRY CONFIG_ESP_MAXIMUM_RETRY
+#define WIFI_BACKOFF_BASE_MS CONFIG_WIFI_BACKOFF_BASE_MS
+#define WIFI_BACKOFF_MAX_MS CONFIG_WIFI_BACKOFF_MAX_MS
+#define WIFI_CONNECT_TIMEOUT_MS CONFIG_WIFI_CONNECT_TIMEOUT_MS
+
+#define WIFI_NVS_NAMESPACE "wifi"
+#define WIFI_NVS_CACHE_KEY "cache"
+
+// Event group for communucating when Wi-Fi is connected
+static EventGroupHandle_t wifiEventGroup;
+#define WIFI_CONN_SUCC BIT0
+#define WIFI_CONN_FAIL BIT1
+
+static int connRetries = 0;
+
+// Our own events, posted from esp_timer callbacks so every state transition happens on the
+// default event loop task alongside the WIFI_EVENT/IP_EVENT handlers
+ESP_EVENT_DEFINE_BASE(WIFI_SM_EVENT);
+enum {
+  WIFI_SM_RETRY,
+  WIFI_SM_TIMEOUT,
+};
+
+static volatile wifi_state_t wifiState = WIFI_STATE_IDLE;
+static esp_timer_handle_t retryTimer;
+static esp_timer_handle_t deadlineTimer;
+
+// Everything needed to skip the channel scan and DHCP on the next wake. Kept in RTC memory for
+// timer wakes and mirrored to NVS so a power cycle doesn't cost us a full scan either.
+typedef struct {
+  uint8_t valid;
+  uint8_t channel;
+  uint8_t bssid[6];
+  esp_netif_ip_info_t ipInfo;  // Zeroed when the fast path should still run DHCP
+  esp_ip4_addr_t dns;
+} wifi_cache_t;
+
+RTC_DATA_ATTR static wifi_cache_t wifiCache;
+
+static esp_netif_t *staNetif;
+static bool fastConnect = false;
+
+static void wifiCacheLoad(void)
+{
+  nvs_handle_t nvs;
+  if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+    return;
+  }
+
+  size_t len = sizeof(wifiCache);
+  if (nvs_get_blob(nvs, WIFI_NVS_CACHE_KEY, &wifiCache, &len) != ESP_OK ||
+      len != sizeof(wifiCache)) {
+    memset(&wifiCache, 0, sizeof(wifiCache));
+  }
+  nvs_close(nvs);
+}
+
+static void wifiCacheStore(void)
+{
+  nvs_handle_t nvs;
+  if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+    return;
+  }
+
+  // Only touch flash when something actually changed
+  wifi_cache_t stored;
+  size_t len = sizeof(stored);
+  if (nvs_get_blob(nvs, WIFI_NVS_CACHE_KEY, &stored, &len) != ESP_OK || len != sizeof(stored) ||
+      memcmp(&stored, &wifiCache, sizeof(stored)) != 0) {
+    if (nvs_set_blob(nvs, WIFI_NVS_CACHE_KEY, &wifiCache, sizeof(wifiCache)) == ESP_OK) {
+      nvs_commit(nvs);
+    }
+  }
+  nvs_close(nvs);
+}
+
+void wifiInvalidateCache(void)
+{
+  if (!wifiCache.valid) {
+    return;
+  }
+  memset(&wifiCache, 0, sizeof(wifiCache));
+  wifiCacheStore();
+}
+
+static void applyIpConfig(void)
+{
+#if CONFIG_ESP_WIFI_STATIC_IP
+  esp_netif_ip_info_t ipInfo = {0};
+  esp_netif_dns_info_t dnsInfo = {0};
+  ipInfo.ip.addr = ipaddr_addr(CONFIG_ESP_WIFI_STATIC_IP_ADDR);
+  ipInfo.netmask.addr = ipaddr_addr(CONFIG_ESP_WIFI_STATIC_NETMASK);
+  ipInfo.gw.addr = ipaddr_addr(CONFIG_ESP_WIFI_STATIC_GATEWAY);
+  dnsInfo.ip.u_addr.ip4.addr = ipaddr_addr(CONFIG_ESP_WIFI_STATIC_DNS);
+#else
+  // Only reuse the lease when we're also reusing the AP it came from
+  if (!fastConnect || wifiCache.ipInfo.ip.addr == 0) {
+    return;
+  }
+  esp_netif_ip_info_t ipInfo = wifiCache.ipInfo;
+  esp_netif_dns_info_t dnsInfo = {0};
+  dnsInfo.ip.u_addr.ip4 = wifiCache.dns;
+#endif
+  dnsInfo.ip.type = ESP_IPADDR_TYPE_V4;
+
+  esp_netif_dhcpc_stop(staNetif);
+  ESP_ERROR_CHECK(esp_netif_set_ip_info(staNetif, &ipInfo));
+  if (dnsInfo.ip.u_addr.ip4.addr != 0) {
+    ESP_ERROR_CHECK(esp_netif_set_dns_info(staNetif, ESP_NETIF_DNS_MAIN, &dnsInfo));
+  }
+}
+
+static void setStaConfig(void)
+{
+  wifi_config_t wifiConfig = {
+      .sta =
+          {
+              .ssid = WIFI_SSID,
+              .password = WIFI_PASS,
+          },
+  };
+
+  if (fastConnect) {
+    // Go straight to the AP we used last time instead of scanning every channel
+    wifiConfig.sta.bssid_set = true;
+    memcpy(wifiConfig.sta.bssid, wifiCache.bssid, sizeof(wifiCache.bssid));
+    wifiConfig.sta.channel = wifiCache.channel;
+    wifiConfig.sta.scan_method = WIFI_FAST_SCAN;
+  } else {
+    wifiConfig.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    wifiConfig.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+  }
+
+  ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifiConfig));
+}
+
+// Cached AP or lease didn't work out, go back to a full scan + DHCP
+static void fallBackToFullScan(void)
+{
+  ESP_LOGW("WIFI", "fast connect failed, falling back to full scan");
+  fastConnect = false;
+  wifiInvalidateCache();
+
+  setStaConfig();
+#if !CONFIG_ESP_WIFI_STATIC_IP
+  esp_netif_dhcpc_start(staNetif);
+#endif
+}
+
+static void postSmEvent(void *arg)
+{
+  esp_event_post(WIFI_SM_EVENT, (int32_t)(intptr_t)arg, NULL, 0, 0);
+}
+
+// Give up on this wake, the caller falls back to deep sleep
+static void connectFailed(void)
+{
+  wifiState = WIFI_STATE_FAILED;
+  esp_timer_stop(retryTimer);
+  esp_timer_stop(deadlineTimer);
+  esp_wifi_disconnect();
+  xEventGroupSetBits(wifiEventGroup, WIFI_CONN_FAIL);
+}
+
+static void scheduleRetry(void)
+{
+  if (connRetries >= WIFI_RETRY) {
+    ESP_LOGW("WIFI", "giving up after %d retries", connRetries);
+    connectFailed();
+    return;
+  }
+
+  // Exponential backoff: base, 2*base, 4*base, ... capped at the max
+  uint32_t delayMs = WIFI_BACKOFF_BASE_MS << (connRetries < 16 ? connRetries : 16);
+  if (delayMs > WIFI_BACKOFF_MAX_MS) {
+    delayMs = WIFI_BACKOFF_MAX_MS;
+  }
+  connRetries++;
+  probeAddRetry();
+
+  ESP_LOGI("WIFI", "retry %d in %lu ms", connRetries, (unsigned long)delayMs);
+  wifiState = WIFI_STATE_BACKOFF;
+  esp_timer_start_once(retryTimer, (uint64_t)delayMs * 1000);
+}
+
+static void wifiEventHandler(void *arg, esp_event_base_t event_base, int32_t event_id,
+                             void *event_data)
+{
+  // Sanity check
+  if (event_base != WIFI_EVENT || wifiState == WIFI_STATE_FAILED) {
+    return;
+  }
+
+  switch (event_id) {
+    case WIFI_EVENT_STA_START:
+      wifiState = WIFI_STATE_CONNECTING;
+      esp_wifi_connect();
+      break;
+
+    case WIFI_EVENT_STA_CONNECTED:
+      probeEnd(PROBE_WIFI_ASSOC);
+      probeBegin(PROBE_DHCP);
+      wifi_event_sta_connected_t *conn = (wifi_event_sta_connected_t *)event_data;
+      memcpy(wifiCache.bssid, conn->bssid, sizeof(wifiCache.bssid));
+      wifiCache.channel = conn->channel;
+      wifiState = WIFI_STATE_ASSOCIATED;
+      break;
+
+    case WIFI_EVENT_STA_DISCONNECTED:
+      if (wifiState == WIFI_STATE_CONNECTED) {
+        // Lost the AP after we were up, nothing in flight is going to finish now
+        connectFailed();
+      } else if (fastConnect) {
+        // Doesn't count as a retry, the cached details were just stale
+        fallBackToFullScan();
+        wifiState = WIFI_STATE_CONNECTING;
+        esp_wifi_connect();
+      } else {
+        scheduleRetry();
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+static void smEventHandler(void *arg, esp_event_base_t event_base, int32_t event_id,
+                           void *event_data)
+{
+  if (wifiState == WIFI_STATE_FAILED || wifiState == WIFI_STATE_CONNECTED) {
+    return;
+  }
+
+  switch (event_id) {
+    case WIFI_SM_RETRY:
+      wifiState = WIFI_STATE_CONNECTING;
+      esp_wifi_connect();
+      break;
+
+    case WIFI_SM_TIMEOUT:
+      ESP_LOGW("WIFI", "no IP after %d ms", WIFI_CONNECT_TIMEOUT_MS);
+      connectFailed();
+      break;
+
+    default:
+      break;
+  }
+}
+
+static void ipEventHandler(void *arg, esp_event_base_t event_base, int32_t event_id,
+                           void *event_data)
+{
+  // Sanity check
+  if (event_base != IP_EVENT || wifiState == WIFI_STATE_FAILED) {
+    return;
+  }
+
+  switch (event_id) {
+    case IP_EVENT_STA_GOT_IP:
+      ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
+      probeEnd(PROBE_DHCP);
+      ESP_LOGI("WIFI", "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+      wifi_ap_record_t ap;
+      if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        probeSetRssi(ap.rssi);
+      }
+      connRetries = 0;
+      wifiState = WIFI_STATE_CONNECTED;
+      esp_timer_stop(deadlineTimer);
+
+      // Remember the AP and lease for the next wake
+      wifiCache.valid = true;
+#if CONFIG_ESP_WIFI_STATIC_IP
+      memset(&wifiCache.ipInfo, 0, sizeof(wifiCache.ipInfo));
+      wifiCache.dns.addr = 0;
+#else
+      wifiCache.ipInfo = event->ip_info;
+      esp_netif_dns_info_t dnsInfo;
+      if (esp_netif_get_dns_info(event->esp_netif, ESP_NETIF_DNS_MAIN, &dnsInfo) == ESP_OK) {
+        wifiCache.dns = dnsInfo.ip.u_addr.ip4;
+      }
+#endif
+      wifiCacheStore();
+
+      xEventGroupSetBits(wifiEventGroup, WIFI_CONN_SUCC);
+      break;
+
+    default:
+      break;
+  }
+}
+
+void wifiStart(void)
+{
+  probeBegin(PROBE_WIFI_ASSOC);
+
+  /* Let's set up Wi-Fi */
+  wifiEventGroup = xEventGroupCreate();
+
+  // Call esp_netif_init() to create LwIP task (TCP/IP Stack)
+  ESP_ERROR_CHECK(esp_netif_init());
+
+  // Create default event loop (this is where we get WIFI and IP Events to handle)
+  ESP_ERROR_CHECK(esp_event_loop_create_default());
+
+  // Create default network interface to bind with TCP/IP stack
+  staNetif = esp_netif_create_default_wifi_sta();
+
+  // Create and initialize Wi-Fi driver task with default config
+  wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+  ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+
+  /* Now we configure the newly created Wi-Fi driver */
+  // Handle any Wi-Fi Event (specifically looking for connect and disconnect events)
+  esp_event_handler_instance_t instance_any_id;
+  ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
+                                                      &wifiEventHandler, NULL, &instance_any_id));
+
+  // Handle station getting an IP address event
+  esp_event_handler_instance_t instance_got_ip;
+  ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
+                                                      &ipEventHandler, NULL, &instance_got_ip));
+
+  // Handle our backoff and deadline timers
+  esp_event_handler_instance_t instance_sm;
+  ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_SM_EVENT, ESP_EVENT_ANY_ID,
+                                                      &smEventHandler, NULL, &instance_sm));
+
+  const esp_timer_create_args_t retryArgs = {
+      .callback = postSmEvent,
+      .arg = (void *)WIFI_SM_RETRY,
+      .name = "wifi_retry",
+  };
+  ESP_ERROR_CHECK(esp_timer_create(&retryArgs, &retryTimer));
+
+  const esp_timer_create_args_t deadlineArgs = {
+      .callback = postSmEvent,
+      .arg = (void *)WIFI_SM_TIMEOUT,
+      .name = "wifi_deadline",
+  };
+  ESP_ERROR_CHECK(esp_timer_create(&deadlineArgs, &deadlineTimer));
+
+  // RTC copy is gone after a power cycle, try the NVS copy
+  if (!wifiCache.valid) {
+    wifiCacheLoad();
+  }
+  fastConnect = wifiCache.valid;
+
+  // Set us to station (client) mode
+  ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+  // Load in our config settings
+  setStaConfig();
+  applyIpConfig();
+
+  // The whole connection attempt (every retry included) has to fit in this window
+  ESP_ERROR_CHECK(esp_timer_start_once(deadlineTimer, (uint64_t)WIFI_CONNECT_TIMEOUT_MS * 1000));
+  // Start the Wi-Fi module, everything from here on is driven by events
+  ESP_ERROR_CHECK(esp_wifi_start());
+}
+
+wifi_state_t wifiGetState(void)
+{
+  return wifiState;
+}
+
+bool wifiWaitConnected(void)
+{
+  /* Now we just wait to connect or fail to connect (the deadline timer bounds this) */
+  EventBits_t bits = xEventGroupWaitBits(wifiEventGroup, WIFI_CONN_SUCC | WIFI_CONN_FAIL, pdFALSE,
+                                         pdFALSE, portMAX_DELAY);
+
+  // Check the EventBits to see what happened
+  if (bits & WIFI_CONN_SUCC) {
+    ESP_LOGI("WIFI", "connected to ap SSID:%s (%s)", WIFI_SSID, fastConnect ? "fast" : "scan");
+    return true;
+  } else if (bits & WIFI_CONN_FAIL) {
+    ESP_LOGI("WIFI", "Failed to connect to SSID:%s", WIFI_SSID);
+  } else {
+    ESP_LOGE("WIFI", "UNEXPECTED EVENT");
+  }
+  return false;
+}